@@ -65,8 +65,11 @@ typedef struct
 void  DrawPlayerWeapon(void);
 boolean TransformPlane (int x1, int y1, int x2, int y2, visobj_t * plane);
 int   CalcRotate (objtype *ob);
+void  ClearVisibleSpots (void);
+void  MarkNearSpots (void);
 void  DrawScaleds (void);
 void  FixOfs (void);
 void SetSpriteLightLevel (int x, int y, visobj_t * sprite, int dir, int fullbright);
+void  SetupWallLights (void);
 
 #endif
@@ -18,7 +18,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef _rt_net_private
 #define _rt_net_private
 
-#define DEMOBUFFSIZE 50000
+// Size of each of the two demo record buffers
+#define DEMOBUFFSIZE 0x8000
+
+#define DEMOTEMPNAME DATADIR "DEMOREC.TMP"
 
 #define FASTSPEED (0xB000)
 
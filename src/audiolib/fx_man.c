@@ -998,6 +998,90 @@ int FX_StopAllSounds
    }
 
 
+/*---------------------------------------------------------------------
+   Function: FX_ServiceVoices
+
+   Multivoc calls back from its own mixer, nothing is queued here.
+---------------------------------------------------------------------*/
+
+void FX_ServiceVoices
+   (
+   void
+   )
+
+   {
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SetOcclusion
+
+   Multivoc has no filters, occluded voices play unchanged.
+---------------------------------------------------------------------*/
+
+int FX_SetOcclusion
+   (
+   int handle,
+   int occluded
+   )
+
+   {
+   ( void )handle;
+   ( void )occluded;
+
+   return( FX_Ok );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_FlushVoiceUpdates
+
+   Multivoc applies pan and pitch changes immediately, nothing is staged.
+---------------------------------------------------------------------*/
+
+void FX_FlushVoiceUpdates
+   (
+   void
+   )
+
+   {
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_SetOutputFile
+
+   Headless output is only available with the OpenAL library.
+---------------------------------------------------------------------*/
+
+void FX_SetOutputFile
+   (
+   const char *name
+   )
+
+   {
+   ( void )name;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetMixStats
+
+   Headless output is only available with the OpenAL library.
+---------------------------------------------------------------------*/
+
+void FX_GetMixStats
+   (
+   unsigned long *frames,
+   unsigned long *usec
+   )
+
+   {
+   *frames = 0;
+   *usec = 0;
+   }
+
+
 /*---------------------------------------------------------------------
    Function: FX_StartDemandFeedPlayback
 
@@ -16,11 +16,17 @@ extern "C"
 #include <zmusic.h>
 
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
 
 static int revstereo = 0;
 static ALCdevice* Device;
 static ALCcontext* Context;
 static ALuint globalSlot = 0, globalEffects[4] = { 0, 0, 0, 0};
+static int currentEffect = -2;   // -1 is no reverb, -2 not set yet
+static ALuint occlusionFilter = 0;
 
 static void ( *fx_callback )( unsigned long ) = NULL;
 bool OpenALInited = false;
@@ -31,6 +37,81 @@ static unsigned long* callbackvals;
 int voicenum = 0;
 int vol = 0;
 
+/*
+   Voice bookkeeping is owned by the game thread.  The OpenAL event thread
+   only posts the index of a voice that may have stopped into stopqueue,
+   the game thread confirms it with a single source query, runs the sound
+   callback and returns the voice to the free list, so starting a sound
+   never polls every source and fx_callback never runs on the audio thread.
+*/
+
+enum { VOICE_FREE, VOICE_PLAYING };
+
+/*
+   Pan and pitch changes made during a tic are staged on the voice and
+   sent to OpenAL together by FX_FlushVoiceUpdates, inside one deferred
+   update batch, so a voice re-panned several times costs one source
+   update and the mixer never sees half of a tic's changes.
+*/
+
+#define STAGE_LISTED   1
+#define STAGE_POSITION 2
+#define STAGE_PITCH    4
+#define STAGE_OCCLUDED 8
+
+typedef struct
+   {
+   int state;
+   int priority;
+   int angle;
+   int distance;
+   double pitch;
+   int occluded;
+   int staged;
+   } voice_t;
+
+static voice_t* voices;
+static int* freevoices;
+static int numfree = 0;
+static int* stagedvoices;
+static int numstaged = 0;
+static bool deferupdates = false;
+
+static int* stopqueue;
+static unsigned stopqueuemask;
+static std::atomic<unsigned> stophead( 0 );
+static std::atomic<unsigned> stoptail( 0 );
+static std::atomic<bool> stopoverflow( false );
+
+// Source name to voice index, written once in FX_Init and read-only after
+static ALuint* voicehashkeys;
+static int* voicehash;
+static unsigned voicehashmask;
+
+#define VOICEHASH( name ) ( ( (name) * 2654435761u ) & voicehashmask )
+
+/*
+   Headless output.  When FX_SetOutputFile has named a file, or there is
+   no audio device, OpenAL is opened as a loopback device and a thread
+   pulls the mix at real-time pace, writing it to a WAV file or throwing
+   it away.  Everything above the device, voices, pitch, reverb and music,
+   runs unchanged, so the mix cost can be measured on machines without
+   sound hardware.
+*/
+
+#define LOOPBACKRATE   44100
+#define LOOPBACKFRAMES 1024
+
+static bool outputset = false;
+static std::string outputname;
+static bool loopback = false;
+static FILE* wavfile = NULL;
+static unsigned long wavbytes;
+static std::thread loopbackthread;
+static std::atomic<bool> loopbackrunning( false );
+static std::atomic<unsigned long> mixframes( 0 );
+static std::atomic<unsigned long> mixtime( 0 );
+
 int FX_ErrorCode = FX_Ok;
 
 #define FX_SetErrorCode( status ) \
@@ -67,24 +148,503 @@ int FX_GetReverseStereo
    return revstereo;
    }
 
+/*---------------------------------------------------------------------
+   Function: PostStoppedVoice
+
+   Called from the OpenAL event thread.  Queues a voice for the game
+   thread to reclaim; if the queue is full the next reclaim rescans
+   every voice instead.
+---------------------------------------------------------------------*/
+
+static void PostStoppedVoice
+   (
+   int voice
+   )
+
+   {
+   unsigned head = stophead.load( std::memory_order_relaxed );
+
+   if ( head - stoptail.load( std::memory_order_acquire ) > stopqueuemask )
+      {
+      stopoverflow.store( true, std::memory_order_release );
+      return;
+      }
+
+   stopqueue[ head & stopqueuemask ] = voice;
+   stophead.store( head + 1, std::memory_order_release );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FreeVoice
+
+   Returns a voice to the free list.
+---------------------------------------------------------------------*/
+
+static void FreeVoice
+   (
+   int voice
+   )
+
+   {
+   if ( voices[ voice ].state == VOICE_FREE )
+      {
+      return;
+      }
+
+   voices[ voice ].state = VOICE_FREE;
+   voices[ voice ].staged &= STAGE_LISTED;
+   freevoices[ numfree++ ] = voice;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: StageVoice
+
+   Marks a voice as changed this tic.
+---------------------------------------------------------------------*/
+
+static void StageVoice
+   (
+   int voice,
+   int change
+   )
+
+   {
+   if ( !( voices[ voice ].staged & STAGE_LISTED ) )
+      {
+      stagedvoices[ numstaged++ ] = voice;
+      }
+   voices[ voice ].staged |= STAGE_LISTED | change;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: SetVoicePosition
+
+   Places a voice's source from its angle and distance.
+---------------------------------------------------------------------*/
+
+static void SetVoicePosition
+   (
+   int voice
+   )
+
+   {
+   int angle = voices[ voice ].angle;
+   int distance = voices[ voice ].distance;
+
+   alSource3f( source[ voice ], AL_POSITION,
+      cos( 0.5235987755982988 * angle ) * distance,
+      sin( 0.5235987755982988 * angle ) * distance, 0 );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: ReclaimVoice
+
+   Frees a voice the event thread reported, unless it was restarted
+   after the event was posted.
+---------------------------------------------------------------------*/
+
+static void ReclaimVoice
+   (
+   int voice
+   )
+
+   {
+   ALint val;
+
+   if ( voices[ voice ].state == VOICE_FREE )
+      {
+      return;
+      }
+
+   alGetSourcei( source[ voice ], AL_SOURCE_STATE, &val );
+   if ( val == AL_STOPPED || val == AL_INITIAL )
+      {
+      if ( callbackvals[ voice ] != (unsigned long)-1 )
+         {
+         fx_callback( callbackvals[ voice ] );
+         callbackvals[ voice ] = -1;
+         }
+      FreeVoice( voice );
+      }
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: ReclaimStoppedVoices
+
+   Drains the stop queue on the game thread.
+---------------------------------------------------------------------*/
+
+static void ReclaimStoppedVoices
+   (
+   void
+   )
+
+   {
+   unsigned tail = stoptail.load( std::memory_order_relaxed );
+   unsigned head = stophead.load( std::memory_order_acquire );
+   int i;
+
+   while ( tail != head )
+      {
+      ReclaimVoice( stopqueue[ tail & stopqueuemask ] );
+      tail++;
+      }
+   stoptail.store( tail, std::memory_order_release );
+
+   if ( stopoverflow.exchange( false, std::memory_order_acq_rel ) )
+      {
+      for ( i = 0; i < voicenum; i++ )
+         {
+         ReclaimVoice( i );
+         }
+      }
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FindStealableVoice
+
+   Returns the playing voice with the lowest priority, the most distant
+   one among equals, if a sound of the given priority may replace it.
+---------------------------------------------------------------------*/
+
+static int FindStealableVoice
+   (
+   int priority
+   )
+
+   {
+   int best = -1;
+   int i;
+
+   for ( i = 0; i < voicenum; i++ )
+      {
+      if ( voices[ i ].state != VOICE_PLAYING )
+         {
+         continue;
+         }
+      if ( ( best == -1 ) ||
+         ( voices[ i ].priority < voices[ best ].priority ) ||
+         ( ( voices[ i ].priority == voices[ best ].priority ) &&
+         ( voices[ i ].distance > voices[ best ].distance ) ) )
+         {
+         best = i;
+         }
+      }
+
+   if ( ( best != -1 ) && ( priority >= voices[ best ].priority ) )
+      {
+      return best;
+      }
+   return -1;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: HandleToVoice
+
+   Maps an FX handle, the OpenAL source name, back to its voice.  Safe
+   to call from the event thread.
+---------------------------------------------------------------------*/
+
+static int HandleToVoice
+   (
+   int handle
+   )
+
+   {
+   unsigned slot;
+
+   if ( voicehash == NULL )
+      {
+      return -1;
+      }
+
+   for ( slot = VOICEHASH( (ALuint)handle ); voicehash[ slot ] != -1;
+      slot = ( slot + 1 ) & voicehashmask )
+      {
+      if ( voicehashkeys[ slot ] == (ALuint)handle )
+         {
+         return voicehash[ slot ];
+         }
+      }
+   return -1;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_ServiceVoices
+
+   Reclaims voices that stopped since the last call and runs their
+   callbacks.  Called once per tic from the game thread.
+---------------------------------------------------------------------*/
+
+void FX_ServiceVoices
+   (
+   void
+   )
+
+   {
+   if ( !OpenALInited )
+      {
+      return;
+      }
+
+   ReclaimStoppedVoices();
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_FlushVoiceUpdates
+
+   Sends the pan and pitch changes staged since the last flush to
+   OpenAL as one batch.  Called once per game update.
+---------------------------------------------------------------------*/
+
+void FX_FlushVoiceUpdates
+   (
+   void
+   )
+
+   {
+   int i;
+   int voice;
+
+   if ( !OpenALInited || ( numstaged == 0 ) )
+      {
+      return;
+      }
+
+   if ( deferupdates )
+      {
+      alDeferUpdatesSOFT();
+      }
+   else
+      {
+      alcSuspendContext( Context );
+      }
+
+   for ( i = 0; i < numstaged; i++ )
+      {
+      voice = stagedvoices[ i ];
+      if ( voices[ voice ].state == VOICE_PLAYING )
+         {
+         if ( voices[ voice ].staged & STAGE_POSITION )
+            {
+            SetVoicePosition( voice );
+            }
+         if ( voices[ voice ].staged & STAGE_PITCH )
+            {
+            alSourcedSOFT( source[ voice ], AL_PITCH, voices[ voice ].pitch );
+            }
+         if ( voices[ voice ].staged & STAGE_OCCLUDED )
+            {
+            alSourcei( source[ voice ], AL_DIRECT_FILTER, voices[ voice ].occluded ?
+               (ALint)occlusionFilter : AL_FILTER_NULL );
+            }
+         }
+      voices[ voice ].staged = 0;
+      }
+   numstaged = 0;
+
+   if ( deferupdates )
+      {
+      alProcessUpdatesSOFT();
+      }
+   else
+      {
+      alcProcessContext( Context );
+      }
+   }
+
 void AL_APIENTRY OALCallback(ALenum eventType, ALuint object, ALuint param, ALsizei length, const ALchar *message, ALvoid *userParam)
 {
     if (eventType == AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT
-    && (param == AL_STOPPED || AL_INITIAL))
+    && (param == AL_STOPPED || param == AL_INITIAL))
     {
-        int i = 0;
+        int voice = HandleToVoice(object);
 
-        for (i = 0; i < voicenum; i++)
-        {
-            if (source[i] == object && callbackvals[i] != -1)
-            {
-                fx_callback(callbackvals[i]);
-                callbackvals[i] = -1;
-            }
-        }
+        if (voice != -1)
+            PostStoppedVoice(voice);
     }
 }
 
+/*---------------------------------------------------------------------
+   Function: FX_SetOutputFile
+
+   Mix to a WAV file instead of the audio device.  NULL restores the
+   device, "" or "null" mixes without keeping the output.  Takes effect
+   at the next FX_Init.
+---------------------------------------------------------------------*/
+
+void FX_SetOutputFile
+   (
+   const char *name
+   )
+
+   {
+   outputset = ( name != NULL );
+   outputname = ( name != NULL ) ? name : "";
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: FX_GetMixStats
+
+   Returns how many frames the headless mixer has produced and how many
+   microseconds it spent mixing them.
+---------------------------------------------------------------------*/
+
+void FX_GetMixStats
+   (
+   unsigned long *frames,
+   unsigned long *usec
+   )
+
+   {
+   *frames = mixframes;
+   *usec = mixtime;
+   }
+
+
+static void PutWavLong( unsigned char *p, unsigned long value )
+   {
+   p[ 0 ] = value & 0xff;
+   p[ 1 ] = ( value >> 8 ) & 0xff;
+   p[ 2 ] = ( value >> 16 ) & 0xff;
+   p[ 3 ] = ( value >> 24 ) & 0xff;
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: WriteWavHeader
+
+   Writes a 16 bit stereo RIFF header for wavbytes of sample data.
+---------------------------------------------------------------------*/
+
+static void WriteWavHeader
+   (
+   void
+   )
+
+   {
+   unsigned char header[ 44 ];
+
+   memcpy( header, "RIFF", 4 );
+   PutWavLong( header + 4, 36 + wavbytes );
+   memcpy( header + 8, "WAVEfmt ", 8 );
+   PutWavLong( header + 16, 16 );
+   PutWavLong( header + 20, 1 | ( 2 << 16 ) );          // PCM, 2 channels
+   PutWavLong( header + 24, LOOPBACKRATE );
+   PutWavLong( header + 28, LOOPBACKRATE * 4 );
+   PutWavLong( header + 32, 4 | ( 16 << 16 ) );         // block align, bits
+   memcpy( header + 36, "data", 4 );
+   PutWavLong( header + 40, wavbytes );
+
+   fseek( wavfile, 0, SEEK_SET );
+   fwrite( header, sizeof( header ), 1, wavfile );
+   fseek( wavfile, 0, SEEK_END );
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: LoopbackMixer
+
+   Pulls blocks from the loopback device at the rate a sound card would.
+---------------------------------------------------------------------*/
+
+static void LoopbackMixer
+   (
+   void
+   )
+
+   {
+   short block[ LOOPBACKFRAMES * 2 ];
+   unsigned long long frames = 0;
+   auto start = std::chrono::steady_clock::now();
+
+   while ( loopbackrunning )
+      {
+      auto mixstart = std::chrono::steady_clock::now();
+
+      alcRenderSamplesSOFT( Device, block, LOOPBACKFRAMES );
+      mixtime += (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now() - mixstart ).count();
+      mixframes += LOOPBACKFRAMES;
+
+      if ( wavfile != NULL )
+         {
+         fwrite( block, sizeof( block ), 1, wavfile );
+         wavbytes += sizeof( block );
+         }
+
+      // Pace from the start so rounding never drifts
+      frames += LOOPBACKFRAMES;
+      std::this_thread::sleep_until( start +
+         std::chrono::microseconds( frames * 1000000 / LOOPBACKRATE ) );
+      }
+   }
+
+
+/*---------------------------------------------------------------------
+   Function: OpenLoopback
+
+   Opens the loopback device and its context for headless output.
+---------------------------------------------------------------------*/
+
+static int OpenLoopback
+   (
+   void
+   )
+
+   {
+   ALCint attrs[] =
+      {
+      ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT,
+      ALC_FORMAT_TYPE_SOFT, ALC_SHORT_SOFT,
+      ALC_FREQUENCY, LOOPBACKRATE,
+      0
+      };
+
+   Device = alcLoopbackOpenDeviceSOFT( NULL );
+   if ( Device == NULL )
+      {
+      return FX_Error;
+      }
+
+   Context = alcCreateContext( Device, attrs );
+   if ( Context == NULL )
+      {
+      alcCloseDevice( Device );
+      return FX_Error;
+      }
+   alcMakeContextCurrent( Context );
+
+   if ( outputset && !outputname.empty() && ( outputname != "null" ) )
+      {
+      wavfile = fopen( outputname.c_str(), "wb" );
+      if ( wavfile == NULL )
+         {
+         fprintf( stderr, "Could not create %s, mixing without output.\n",
+            outputname.c_str() );
+         }
+      else
+         {
+         wavbytes = 0;
+         WriteWavHeader();
+         }
+      }
+
+   loopback = true;
+   return FX_Ok;
+   }
+
+
 /* LoadEffect loads the given reverb properties into a new OpenAL effect
  * object, and returns the new effect ID. */
 static ALuint LoadEffect(const EFXEAXREVERBPROPERTIES *reverb)
@@ -178,7 +738,12 @@ FX_Init( int SoundCard, int numvoices, int numchannels, int samplebits, unsigned
     EFXEAXREVERBPROPERTIES prop2 = EFX_REVERB_PRESET_SEWERPIPE2;
     EFXEAXREVERBPROPERTIES prop3 = EFX_REVERB_PRESET_SEWERPIPE3;
 
-	Device = alcOpenDevice(NULL); // select the "preferred device" 
+	loopback = false;
+	if (!outputset)
+		Device = alcOpenDevice(NULL); // select the "preferred device" 
+	else
+		Device = NULL;
+
 	if (Device)
 	{
 		Context = alcCreateContext(Device, NULL);
@@ -186,7 +751,10 @@ FX_Init( int SoundCard, int numvoices, int numchannels, int samplebits, unsigned
     }
     else
     {
-        return FX_Error;
+        if (!outputset)
+            fprintf(stderr, "No audio device, mixing without output.\n");
+        if (OpenLoopback() != FX_Ok)
+            return FX_Error;
     }
 	ALenum error = alGetError(); // clear error code 
     Buffers = (ALuint*)malloc(sizeof(ALuint) * numvoices);
@@ -205,6 +773,46 @@ FX_Init( int SoundCard, int numvoices, int numchannels, int samplebits, unsigned
     {
         callbackvals[i] = -1;
     }
+
+    voices = (voice_t*)calloc(sizeof(voice_t), numvoices);
+    freevoices = (int*)malloc(sizeof(int) * numvoices);
+    stagedvoices = (int*)malloc(sizeof(int) * numvoices);
+    numstaged = 0;
+    numfree = 0;
+    for (i = numvoices - 1; i >= 0; i--)
+    {
+        voices[i].state = VOICE_FREE;
+        freevoices[numfree++] = i;
+    }
+
+    // Room for a few events per voice between reclaims
+    stopqueuemask = 1;
+    while (stopqueuemask < (unsigned)numvoices * 4)
+        stopqueuemask <<= 1;
+    stopqueue = (int*)malloc(sizeof(int) * stopqueuemask);
+    stopqueuemask--;
+    stophead.store(0);
+    stoptail.store(0);
+    stopoverflow.store(false);
+
+    // Keep the source lookup table at most half full
+    voicehashmask = 1;
+    while (voicehashmask < (unsigned)numvoices * 2)
+        voicehashmask <<= 1;
+    voicehashkeys = (ALuint*)malloc(sizeof(ALuint) * voicehashmask);
+    voicehash = (int*)malloc(sizeof(int) * voicehashmask);
+    voicehashmask--;
+    for (i = 0; i <= (int)voicehashmask; i++)
+        voicehash[i] = -1;
+    for (i = 0; i < numvoices; i++)
+    {
+        unsigned slot = VOICEHASH(source[i]);
+
+        while (voicehash[slot] != -1)
+            slot = (slot + 1) & voicehashmask;
+        voicehashkeys[slot] = source[i];
+        voicehash[slot] = i;
+    }
     OpenALInited = true;
     voicenum = numvoices;
     
@@ -215,11 +823,25 @@ FX_Init( int SoundCard, int numvoices, int numchannels, int samplebits, unsigned
         alSourcef(source[i], AL_MAX_DISTANCE, 255);
     }
     alDistanceModel(AL_LINEAR_DISTANCE);
+    deferupdates = alIsExtensionPresent("AL_SOFT_deferred_updates");
     globalEffects[0] = LoadEffect(&prop);
     globalEffects[1] = LoadEffect(&prop1);
     globalEffects[2] = LoadEffect(&prop2);
     globalEffects[3] = LoadEffect(&prop3);
     alGenAuxiliaryEffectSlots(1, &globalSlot);
+    currentEffect = -2;
+
+    // Sound from areas the listener can't reach comes through the walls muffled
+    alGenFilters(1, &occlusionFilter);
+    alFilteri(occlusionFilter, AL_FILTER_TYPE, AL_FILTER_LOWPASS);
+    alFilterf(occlusionFilter, AL_LOWPASS_GAIN, 0.5f);
+    alFilterf(occlusionFilter, AL_LOWPASS_GAINHF, 0.1f);
+
+    if (loopback)
+    {
+        loopbackrunning = true;
+        loopbackthread = std::thread(LoopbackMixer);
+    }
 
 	return FX_Ok;
 }
@@ -231,6 +853,8 @@ int FX_Shutdown( void )
     alDeleteAuxiliaryEffectSlots(1, &globalSlot);
     alDeleteEffects(4, globalEffects);
     globalSlot = 0;
+    alDeleteFilters(1, &occlusionFilter);
+    occlusionFilter = 0;
     alEventCallbackSOFT(NULL, NULL);
 	for (i = 0; i < voicenum; i++)
 	{
@@ -239,6 +863,28 @@ int FX_Shutdown( void )
 	}
     alDeleteSources(voicenum, source);
     alDeleteBuffers(voicenum, Buffers);
+    free(voices);
+    free(freevoices);
+    free(stagedvoices);
+    numstaged = 0;
+    free(stopqueue);
+    free(voicehashkeys);
+    free(voicehash);
+    voicehash = NULL;
+    numfree = 0;
+    OpenALInited = false;
+    if (loopback)
+    {
+        loopbackrunning = false;
+        loopbackthread.join();
+        if (wavfile != NULL)
+        {
+            WriteWavHeader();
+            fclose(wavfile);
+            wavfile = NULL;
+        }
+        loopback = false;
+    }
     alcMakeContextCurrent(NULL);
 	alcDestroyContext(Context);
 	alcCloseDevice(Device);
@@ -263,50 +909,45 @@ int FX_GetVolume(void)
 }
 int FX_VoiceAvailable(int priority)
 {
-    int i = 0;
-    for (i = 0; i < voicenum; i++)
-    {
-        int val;
-        alGetSourcei(source[i], AL_SOURCE_STATE, &val);
-        if (val == AL_STOPPED || val == AL_INITIAL)
-            return 1;
-    }
-    return 0;
+    ReclaimStoppedVoices();
+    if (numfree > 0)
+        return 1;
+    return (FindStealableVoice(priority) != -1);
 }
 
 int FX_SoundActive( int handle )
 {
-    int val = AL_STOPPED;
-    alGetSourcei(handle, AL_SOURCE_STATE, &val);
-    return (val == AL_PLAYING);
+    int voice;
+
+    ReclaimStoppedVoices();
+    voice = HandleToVoice(handle);
+    if (voice == -1)
+        return 0;
+    return (voices[voice].state == VOICE_PLAYING);
 }
 
 int FX_SoundsPlaying( void )
 {
-    int i = 0;
-    for (i = 0; i < voicenum; i++)
-    {
-        int val;
-        alGetSourcei(source[i], AL_SOURCE_STATE, &val);
-        if (val == AL_PLAYING)
-            return 1;
-    }
-    return 0;
+    ReclaimStoppedVoices();
+    return (numfree < voicenum);
 }
 
 int FX_StopSound( int handle )
 {
-    int i = 0;
+    int voice;
+
     alSourceStop(handle);
 
-    for (i = 0; i < voicenum; i++)
+    voice = HandleToVoice(handle);
+    if (voice == -1)
+        return FX_Ok;
+
+    if (callbackvals[voice] != (unsigned long)-1)
     {
-        if (source[i] == handle && callbackvals[i] != -1)
-        {
-            fx_callback(callbackvals[i]);
-            callbackvals[i] = -1;
-        }
+        fx_callback(callbackvals[voice]);
+        callbackvals[voice] = -1;
     }
+    FreeVoice(voice);
     return FX_Ok;
 }
 
@@ -315,7 +956,7 @@ int FX_StopAllSounds( void )
     int i = 0;
     for (i = 0; i < voicenum; i++)
     {
-        alSourceStop(source[i]);
+        FX_StopSound(source[i]);
     }
     return FX_Ok;
 }
@@ -370,21 +1011,33 @@ int FX_SetupCard(int SoundCard, fx_device* device)
 void  FX_SetReverb( int reverb )
 {
     ALint effect = AL_EFFECT_NULL;
+    int index = -1;
     if (reverb >= 220)
-        effect = globalEffects[0];
+        index = 0;
     else if (reverb >= 180)
-        effect = globalEffects[2];
+        index = 2;
     else if (reverb >= 64)
-        effect = globalEffects[3];
+        index = 3;
     else if (reverb != 0)
-        effect = globalEffects[1];
+        index = 1;
+
+    // Levels in the same band share an effect, and the voices only need
+    // their sends changed when reverb is switched on or off
+    if (index == currentEffect)
+        return;
+    bool resend = (currentEffect == -2) || ((currentEffect == -1) != (index == -1));
+    currentEffect = index;
+    if (index != -1)
+        effect = globalEffects[index];
+
     if (reverb != 0)
     {
         alAuxiliaryEffectSloti(globalSlot, AL_EFFECTSLOT_EFFECT, effect);
-        for (int i = 0; i < voicenum; i++)
-            alSource3i(source[i], AL_AUXILIARY_SEND_FILTER, (ALint)globalSlot, 0, AL_FILTER_NULL);
+        if (resend)
+            for (int i = 0; i < voicenum; i++)
+                alSource3i(source[i], AL_AUXILIARY_SEND_FILTER, (ALint)globalSlot, 0, AL_FILTER_NULL);
     }
-    else
+    else if (resend)
     {
         for (int i = 0; i < voicenum; i++)
             alSource3i(source[i], AL_AUXILIARY_SEND_FILTER, AL_EFFECTSLOT_NULL, 0, AL_FILTER_NULL);
@@ -565,17 +1218,20 @@ int FX_SetCallBack(void ( *callback )( unsigned long ))
     return FX_Ok;
 }
 
-static int FindVoice(void)
+static int FindVoice(int priority)
 {
-    int i = 0;
-    for (i = 0; i < voicenum; i++)
-    {
-        int val;
-        alGetSourcei(source[i], AL_SOURCE_STATE, &val);
-        if (val == AL_STOPPED || val == AL_INITIAL)
-            return i;
-    }
-    return -1;
+    int voice;
+
+    ReclaimStoppedVoices();
+    if (numfree > 0)
+        return freevoices[--numfree];
+
+    voice = FindStealableVoice(priority);
+    if (voice == -1)
+        return -1;
+
+    FX_StopSound(source[voice]);
+    return freevoices[--numfree];
 }
 
 int FX_PlayVOC3D( char *ptr, int pitchoffset, int angle, int distance,
@@ -590,7 +1246,7 @@ int FX_PlayVOC3D( char *ptr, int pitchoffset, int angle, int distance,
         angle    += 16;
     }
 
-    sourceNum = FindVoice();
+    sourceNum = FindVoice(priority);
     if (sourceNum == -1) {
         fprintf(stderr, "Failed to find a free voice.\n");
         return -1;
@@ -621,6 +1277,7 @@ int FX_PlayVOC3D( char *ptr, int pitchoffset, int angle, int distance,
         if (format == AL_NONE)
         {
             SoundDecoder_Close(decoder);
+            freevoices[numfree++] = sourceNum;
             return FX_Error;
         }
 #if 0
@@ -650,17 +1307,30 @@ int FX_PlayVOC3D( char *ptr, int pitchoffset, int angle, int distance,
         (void)samplesize;
         angle &= 31;
 
-        alSource3f(source[sourceNum], AL_POSITION, cos(0.5235987755982988 * angle) * distance, sin(0.5235987755982988 * angle) * distance, 0);
+        // A stolen voice may still have the old sound's changes staged
+        voices[sourceNum].staged &= STAGE_LISTED;
+        voices[sourceNum].angle = angle;
+        voices[sourceNum].distance = distance;
+        voices[sourceNum].pitch = FixedToFloat(PITCH_GetScale(pitchoffset));
+        SetVoicePosition(sourceNum);
+        if (voices[sourceNum].occluded)
+        {
+            voices[sourceNum].occluded = 0;
+            alSourcei(source[sourceNum], AL_DIRECT_FILTER, AL_FILTER_NULL);
+        }
         alSource3f(source[sourceNum], AL_VELOCITY, 0, 0, 0);
         alSource3f(source[sourceNum], AL_DIRECTION, 0, 0, 0);
         alSourcef(source[sourceNum], AL_SOURCE_RELATIVE, AL_TRUE);
         alSourcei(source[sourceNum], AL_BUFFER, Buffers[sourceNum]);
-        alSourcedSOFT(source[sourceNum], AL_PITCH, FixedToFloat(PITCH_GetScale(pitchoffset)));
+        alSourcedSOFT(source[sourceNum], AL_PITCH, voices[sourceNum].pitch);
         
         callbackvals[sourceNum] = callbackval;
+        voices[sourceNum].state = VOICE_PLAYING;
+        voices[sourceNum].priority = priority;
         alSourcePlay(source[sourceNum]);
         return source[sourceNum];
     }
+    freevoices[numfree++] = sourceNum;
     return FX_Error;
 }
 
@@ -672,6 +1342,69 @@ int FX_PlayWAV3D( char *ptr, int pitchoffset, int angle, int distance,
 
 int FX_SetPitch(int handle, int pitchoffset)
 {
-    alSourcedSOFT(handle, AL_PITCH, FixedToFloat(PITCH_GetScale(pitchoffset)));
+    int voice = HandleToVoice(handle);
+    double pitch = FixedToFloat(PITCH_GetScale(pitchoffset));
+
+    if (voice == -1 || voices[voice].state != VOICE_PLAYING)
+        return FX_Warning;
+
+    if (pitch != voices[voice].pitch)
+    {
+        voices[voice].pitch = pitch;
+        StageVoice(voice, STAGE_PITCH);
+    }
+    return FX_Ok;
+}
+
+int FX_Pan3D(int handle, int angle, int distance)
+{
+    int voice = HandleToVoice(handle);
+
+    if (voice == -1 || voices[voice].state != VOICE_PLAYING)
+        return FX_Warning;
+
+    if (distance < 0)
+    {
+        distance = -distance;
+        angle += 16;
+    }
+    angle &= 31;
+
+    if (angle != voices[voice].angle || distance != voices[voice].distance)
+    {
+        voices[voice].angle = angle;
+        voices[voice].distance = distance;
+        StageVoice(voice, STAGE_POSITION);
+    }
+    return FX_Ok;
+}
+
+int FX_SetOcclusion(int handle, int occluded)
+{
+    int voice = HandleToVoice(handle);
+
+    if (voice == -1 || voices[voice].state != VOICE_PLAYING)
+        return FX_Warning;
+
+    occluded = (occluded != 0);
+    if (occluded != voices[voice].occluded)
+    {
+        voices[voice].occluded = occluded;
+        StageVoice(voice, STAGE_OCCLUDED);
+    }
     return FX_Ok;
+}
+
+// Volume is distance from the listener here, as in FX_PlayVOC3D
+int FX_SetPan(int handle, int volume, int left, int right)
+{
+    int voice = HandleToVoice(handle);
+
+    (void)left;
+    (void)right;
+
+    if (voice == -1)
+        return FX_Warning;
+
+    return FX_Pan3D(handle, voices[voice].angle, 255 - volume);
 }
\ No newline at end of file
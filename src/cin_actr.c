@@ -16,11 +16,14 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+#include "SDL2/SDL.h"
 #include "cin_glob.h"
 #include "cin_def.h"
 #include "cin_actr.h"
 #include "cin_efct.h"
 #include "modexlib.h"
+#include "z_zone.h"
 
 actortype * firstcinematicactor;
 actortype * lastcinematicactor;
@@ -31,6 +34,45 @@ actortype * lastcinematicactor;
 boolean cinematicactorsystemstarted=false;
 static int numcinematicactors;
 
+//
+// Frames that only draw backgrounds, backdrops and sprites are composed
+// ahead on a worker thread while the main thread presents the one
+// before.  Anything touching the palette or the screen directly waits
+// for the queue to empty and runs on the main thread as before.
+//
+
+#define CINEMATICFRAMES  2
+#define MAXLOCKEDLUMPS   64
+
+typedef struct
+{
+    enum_eventtype effecttype;
+    void * lump;
+    union
+    {
+        backevent   back;
+        spriteevent sprite;
+    } effect;
+} cinematicdraw_t;
+
+typedef struct
+{
+    int             numdraws;
+    cinematicdraw_t draws[MAXCINEMATICACTORS];
+    byte          * source;     // what the frame starts from
+    byte          * pixels;
+} cinematicframe_t;
+
+static cinematicframe_t cinematicframes[CINEMATICFRAMES];
+static SDL_Thread * cinematicworker = NULL;
+static SDL_sem    * framequeued;
+static SDL_sem    * framecomposed;
+static boolean      cinematicworkerquit;
+static int          nextframe;
+static int          pendingframe;
+static void       * lockedlumps[MAXLOCKEDLUMPS];
+static int          numlockedlumps;
+
 /*
 ===============
 =
@@ -222,58 +264,305 @@ typedef enum {
     numdrawphases
 } enum_drawphases;
 
+static enum_drawphases CinematicDrawPhase ( enum_eventtype type )
+{
+    switch (type)
+    {
+    case palette:
+        return palettefunctions;
+        break;
+    case background_noscrolling:
+    case background_scrolling:
+    case background_multi:
+        return background;
+        break;
+    case sprite_background:
+        return backgroundsprites;
+        break;
+    case backdrop_noscrolling:
+    case backdrop_scrolling:
+        return backdrop;
+        break;
+    case sprite_foreground:
+        return foregroundsprites;
+        break;
+    default:
+        ;
+    }
+    return screenfunctions;
+}
+
+/*
+===============
+=
+= ComposeCinematicFrame
+=
+===============
+*/
+
+static void ComposeCinematicFrame ( cinematicframe_t * frame )
+{
+    cinematicdraw_t * draw;
+    int i;
+
+    // Backgrounds cover or clear the whole screen, anything else is
+    // drawn over the last frame
+
+    if ((frame->numdraws==0) ||
+            (CinematicDrawPhase(frame->draws[0].effecttype)!=background))
+        memcpy (frame->pixels, frame->source, screensize);
+
+    for (i=0; i<frame->numdraws; i++)
+    {
+        draw=&frame->draws[i];
+        RenderCinematicEffect (draw->effecttype, &draw->effect, draw->lump, frame->pixels);
+    }
+}
+
+/*
+===============
+=
+= CinematicFrameWorker
+=
+===============
+*/
+
+static int CinematicFrameWorker ( void * data )
+{
+    int frame;
+
+    (void)data;
+
+    frame=0;
+    while (1)
+    {
+        SDL_SemWait (framequeued);
+        if (cinematicworkerquit == true)
+            break;
+        ComposeCinematicFrame (&cinematicframes[frame]);
+        frame=(frame+1)%CINEMATICFRAMES;
+        SDL_SemPost (framecomposed);
+    }
+    return 0;
+}
+
+/*
+===============
+=
+= StartupCinematicFrames
+=
+===============
+*/
+
+void StartupCinematicFrames ( void )
+{
+    int i;
+
+    if (cinematicworker != NULL)
+        return;
+
+    nextframe=0;
+    pendingframe=-1;
+    numlockedlumps=0;
+    cinematicworkerquit=false;
+
+    framequeued = SDL_CreateSemaphore (0);
+    framecomposed = SDL_CreateSemaphore (0);
+    for (i=0; i<CINEMATICFRAMES; i++)
+        cinematicframes[i].pixels=SafeMalloc (screensize);
+
+    cinematicworker = SDL_CreateThread (CinematicFrameWorker, "cinematic", NULL);
+
+    // Without a thread every frame is drawn in place as before
+
+    if (cinematicworker == NULL)
+    {
+        for (i=0; i<CINEMATICFRAMES; i++)
+            SafeFree (cinematicframes[i].pixels);
+        SDL_DestroySemaphore (framequeued);
+        SDL_DestroySemaphore (framecomposed);
+    }
+}
+
+/*
+===============
+=
+= FinishCinematicFrames
+=
+= Presents the frame still being composed and releases the lumps the
+= queued frames held on to
+=
+===============
+*/
+
+void FinishCinematicFrames ( void )
+{
+    int i;
+
+    if (cinematicworker == NULL)
+        return;
+
+    if (pendingframe >= 0)
+    {
+        SDL_SemWait (framecomposed);
+        memcpy ((byte *)bufferofs, cinematicframes[pendingframe].pixels, screensize);
+        XFlipPage ();
+        pendingframe=-1;
+    }
+
+    for (i=0; i<numlockedlumps; i++)
+        Z_ChangeTag (lockedlumps[i], PU_CACHE);
+    numlockedlumps=0;
+}
+
+/*
+===============
+=
+= ShutdownCinematicFrames
+=
+===============
+*/
+
+void ShutdownCinematicFrames ( void )
+{
+    int i;
+
+    if (cinematicworker == NULL)
+        return;
+
+    FinishCinematicFrames ();
+
+    cinematicworkerquit=true;
+    SDL_SemPost (framequeued);
+    SDL_WaitThread (cinematicworker, NULL);
+    cinematicworker=NULL;
+
+    SDL_DestroySemaphore (framequeued);
+    SDL_DestroySemaphore (framecomposed);
+    for (i=0; i<CINEMATICFRAMES; i++)
+        SafeFree (cinematicframes[i].pixels);
+}
+
+/*
+===============
+=
+= LockCinematicLump
+=
+= Keeps a lump from being purged while the worker may still read it
+=
+===============
+*/
+
+static void * LockCinematicLump ( enum_eventtype type, void * effect )
+{
+    void * lump;
+    int i;
+
+    lump=CacheCinematicEffect (type, effect, PU_STATIC);
+    if (lump == NULL)
+        return NULL;
+
+    for (i=0; i<numlockedlumps; i++)
+        if (lockedlumps[i] == lump)
+            return lump;
+
+    lockedlumps[numlockedlumps++]=lump;
+    return lump;
+}
+
+/*
+===============
+=
+= QueueCinematicFrame
+=
+= Hands the current state of the actors to the worker, then presents
+= the frame queued last time
+=
+===============
+*/
+
+static void QueueCinematicFrame ( void )
+{
+    cinematicframe_t * frame;
+    cinematicdraw_t * draw;
+    actortype * actor;
+    enum_drawphases sequence;
+
+    if (numlockedlumps+MAXCINEMATICACTORS > MAXLOCKEDLUMPS)
+        FinishCinematicFrames ();
+
+    frame=&cinematicframes[nextframe];
+    frame->numdraws=0;
+    if (pendingframe >= 0)
+        frame->source=cinematicframes[pendingframe].pixels;
+    else
+        frame->source=(byte *)bufferofs;
+
+    for (sequence=background; sequence<=foregroundsprites; sequence++)
+    {
+        for (actor=firstcinematicactor; actor != NULL; actor=actor->next)
+        {
+            if (CinematicDrawPhase(actor->effecttype) != sequence)
+                continue;
+
+            draw=&frame->draws[frame->numdraws++];
+            draw->effecttype=actor->effecttype;
+            if (sequence==background || sequence==backdrop)
+                draw->effect.back=*(backevent *)actor->effect;
+            else
+                draw->effect.sprite=*(spriteevent *)actor->effect;
+            draw->lump=LockCinematicLump (draw->effecttype, &draw->effect);
+        }
+    }
+
+    SDL_SemPost (framequeued);
+
+    if (pendingframe >= 0)
+    {
+        SDL_SemWait (framecomposed);
+        memcpy ((byte *)bufferofs, cinematicframes[pendingframe].pixels, screensize);
+        XFlipPage ();
+    }
+    pendingframe=nextframe;
+    nextframe=(nextframe+1)%CINEMATICFRAMES;
+}
+
 void DrawCinematicActors ( void )
 {
     actortype * actor;
     actortype * nextactor;
     boolean draw;
     enum_drawphases sequence;
+    enum_drawphases phase;
 #if DUMP
     int numactors=0;
 #endif
     boolean flippage=true;
 
+    if (cinematicworker != NULL)
+    {
+        for (actor=firstcinematicactor; actor != NULL; actor=actor->next)
+        {
+            phase=CinematicDrawPhase(actor->effecttype);
+            if ((phase==screenfunctions) || (phase==palettefunctions))
+                break;
+        }
+        if (actor == NULL)
+        {
+            QueueCinematicFrame ();
+            return;
+        }
+        FinishCinematicFrames ();
+    }
+
     for (sequence=screenfunctions; sequence<numdrawphases; sequence++)
     {
         for (actor=firstcinematicactor; actor != NULL;)
         {
-            draw=false;
-            switch (actor->effecttype)
-            {
-            case fadeout:
-            case blankscreen:
-            case clearbuffer:
-            case cinematicend:
-            case flic:
-                if (sequence==screenfunctions)
-                    draw=true;
+            phase=CinematicDrawPhase(actor->effecttype);
+            draw=(phase==sequence);
+            if ((phase==screenfunctions) || (phase==palettefunctions))
                 flippage=false;
-                break;
-            case palette:
-                if (sequence==palettefunctions)
-                    draw=true;
-                flippage=false;
-                break;
-            case background_noscrolling:
-            case background_scrolling:
-            case background_multi:
-                if (sequence==background)
-                    draw=true;
-                break;
-            case sprite_background:
-                if (sequence==backgroundsprites)
-                    draw=true;
-                break;
-            case backdrop_noscrolling:
-            case backdrop_scrolling:
-                if (sequence==backdrop)
-                    draw=true;
-                break;
-            case sprite_foreground:
-                if (sequence==foregroundsprites)
-                    draw=true;
-                break;
-            }
             nextactor=actor->next;
             if (draw==true)
             {
@@ -297,5 +586,3 @@ void DrawCinematicActors ( void )
     printf("Total actors drawn=%ld\n",numactors);
 #endif
 }
-
-
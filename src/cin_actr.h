@@ -33,6 +33,9 @@ void ShutdownCinematicActors ( void );
 void SpawnCinematicActor ( enum_eventtype type, void * effect );
 void DrawCinematicActors ( void );
 void UpdateCinematicActors ( void );
+void StartupCinematicFrames ( void );
+void FinishCinematicFrames ( void );
+void ShutdownCinematicFrames ( void );
 
 #endif
 
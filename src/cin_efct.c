@@ -20,6 +20,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "cin_util.h"
 #include "cin_def.h"
 #include "cin_main.h"
+#include "cin_efct.h"
 #include "f_scale.h"
 #include "watcom.h"
 #include "lumpy.h"
@@ -320,34 +321,31 @@ void PrecacheFlic (flicevent * flic)
 /*
 ===============
 =
-= DrawCinematicBackground
+= RenderCinematicBackground
 =
 ===============
 */
 
-void DrawCinematicBackground ( backevent * back )
+void RenderCinematicBackground ( backevent * back, lpic_t * pic, byte * buffer )
 {
     byte * src;
     byte * buf;
-    lpic_t * pic;
     int i;
     int plane;
     int offset;
     int height;
 
-    pic=(lpic_t *)W_CacheLumpName(back->name,PU_CACHE, Cvt_lpic_t, 1);
-
     height = pic->height;
     if (height+back->yoffset>iGLOBAL_SCREENHEIGHT)
         height=iGLOBAL_SCREENHEIGHT-back->yoffset;
 
     if (height!=iGLOBAL_SCREENHEIGHT)
-        DrawClearBuffer ();
+        ClearCinematicBuffer (buffer);
 
     plane = 0;
 
     {
-        buf=(byte *)bufferofs+ylookup[back->yoffset];
+        buf=buffer+ylookup[back->yoffset];
         offset=(back->currentoffset>>FRACTIONBITS)+plane;
 
         for (i=0; i<iGLOBAL_SCREENWIDTH; i++,offset++,buf++)
@@ -366,12 +364,12 @@ void DrawCinematicBackground ( backevent * back )
 /*
 ===============
 =
-= DrawCinematicMultiBackground
+= RenderCinematicMultiBackground
 =
 ===============
 */
 
-void DrawCinematicMultiBackground ( backevent * back )
+void RenderCinematicMultiBackground ( backevent * back, byte * buffer )
 {
     byte * src;
     byte * buf;
@@ -385,12 +383,12 @@ void DrawCinematicMultiBackground ( backevent * back )
         height=iGLOBAL_SCREENHEIGHT-back->yoffset;
 
     if (height!=iGLOBAL_SCREENHEIGHT)
-        DrawClearBuffer ();
+        ClearCinematicBuffer (buffer);
 
     plane = 0;
 
     {
-        buf=(byte *)bufferofs+ylookup[back->yoffset];
+        buf=buffer+ylookup[back->yoffset];
         offset=(back->currentoffset>>FRACTIONBITS)+plane;
 
         for (i=0; i<iGLOBAL_SCREENWIDTH; i++,offset++,buf++)
@@ -409,15 +407,14 @@ void DrawCinematicMultiBackground ( backevent * back )
 /*
 ===============
 =
-= DrawCinematicBackdrop
+= RenderCinematicBackdrop
 =
 ===============
 */
 
-void DrawCinematicBackdrop ( backevent * back )
+void RenderCinematicBackdrop ( backevent * back, byte * shape, byte * buffer )
 {
     byte * src;
-    byte * shape;
     byte * buf;
     patch_t * p;
     int i;
@@ -427,7 +424,6 @@ void DrawCinematicBackdrop ( backevent * back )
     int postlength;
     int toppost;
 
-    shape=W_CacheLumpName(back->name,PU_CACHE, Cvt_patch_t, 1);
     p=(patch_t *)shape;
 
     toppost=-p->topoffset+back->yoffset;
@@ -435,7 +431,7 @@ void DrawCinematicBackdrop ( backevent * back )
     plane = 0;
 
     {
-        buf=(byte *)bufferofs;
+        buf=buffer;
         offset=(back->currentoffset>>FRACTIONBITS)+plane;
 
         for (i=0; i<iGLOBAL_SCREENWIDTH; i++,offset++,buf++)
@@ -475,13 +471,12 @@ void PrecacheBack ( backevent * back )
 /*
 =================
 =
-= DrawCinematicSprite
+= RenderCinematicSprite
 =
 =================
 */
-void DrawCinematicSprite ( spriteevent * sprite )
+void RenderCinematicSprite ( spriteevent * sprite, byte * shape, byte * buffer )
 {
-    byte   *shape;
     int    frac;
     patch_t *p;
     int    x1,x2;
@@ -495,13 +490,12 @@ void DrawCinematicSprite ( spriteevent * sprite )
     if (height<2)
         return;
 
-    shape=W_CacheLumpNum( W_GetNumForName(sprite->name)+sprite->frame, PU_CACHE, Cvt_patch_t, 1);
     p=(patch_t *)shape;
 
 
     cin_ycenter=sprite->y >> FRACTIONBITS;
     cin_invscale = (height<<FRACTIONBITS)/p->origsize;
-    buf=(byte *)bufferofs;
+    buf=buffer;
     tx=-p->leftoffset;
     xcent=(sprite->x & 0xffff0000)-(height<<(FRACTIONBITS-1))+(FRACTIONUNIT>>1);
 
@@ -637,7 +631,19 @@ void DrawBlankScreen ( void )
 */
 void DrawClearBuffer ( void )
 {
-    memset((byte *)bufferofs,0,iGLOBAL_SCREENWIDTH*iGLOBAL_SCREENHEIGHT);
+    ClearCinematicBuffer ((byte *)bufferofs);
+}
+
+/*
+=================
+=
+= ClearCinematicBuffer
+=
+=================
+*/
+void ClearCinematicBuffer ( byte * buffer )
+{
+    memset(buffer,0,iGLOBAL_SCREENWIDTH*iGLOBAL_SCREENHEIGHT);
 }
 
 /*
@@ -732,31 +738,94 @@ boolean UpdateCinematicEffect ( enum_eventtype type, void * effect )
 /*
 =================
 =
-= DrawCinematicEffect
+= CacheCinematicEffect
+=
+= Returns the lump an effect draws from, NULL for effects that keep
+= their own copy or draw nothing
 =
 =================
 */
-boolean DrawCinematicEffect ( enum_eventtype type, void * effect )
+void * CacheCinematicEffect ( enum_eventtype type, void * effect, int tag )
 {
     switch (type)
     {
     case background_noscrolling:
     case background_scrolling:
-        DrawCinematicBackground ( (backevent *) effect );
-        return true;
+        return W_CacheLumpName(((backevent *)effect)->name,tag, Cvt_lpic_t, 1);
+        break;
+    case backdrop_scrolling:
+    case backdrop_noscrolling:
+        return W_CacheLumpName(((backevent *)effect)->name,tag, Cvt_patch_t, 1);
+        break;
+    case sprite_background:
+    case sprite_foreground:
+        if ((((spriteevent *)effect)->scale >> FRACTIONBITS) < 2)
+            return NULL;
+        return W_CacheLumpNum( W_GetNumForName(((spriteevent *)effect)->name)+
+                               ((spriteevent *)effect)->frame, tag, Cvt_patch_t, 1);
+        break;
+    default:
+        ;
+    }
+    return NULL;
+}
+
+/*
+=================
+=
+= RenderCinematicEffect
+=
+= Draws one of the effects that only touch the buffer, safe to call off
+= the main thread as long as lump came from CacheCinematicEffect
+=
+=================
+*/
+void RenderCinematicEffect ( enum_eventtype type, void * effect, void * lump, byte * buffer )
+{
+    switch (type)
+    {
+    case background_noscrolling:
+    case background_scrolling:
+        RenderCinematicBackground ( (backevent *) effect, (lpic_t *) lump, buffer );
         break;
     case background_multi:
-        DrawCinematicMultiBackground ( (backevent *) effect );
-        return true;
+        RenderCinematicMultiBackground ( (backevent *) effect, buffer );
         break;
     case backdrop_scrolling:
     case backdrop_noscrolling:
-        DrawCinematicBackdrop ( (backevent *) effect );
-        return true;
+        RenderCinematicBackdrop ( (backevent *) effect, (byte *) lump, buffer );
+        break;
+    case sprite_background:
+    case sprite_foreground:
+        if (lump != NULL)
+            RenderCinematicSprite ( (spriteevent *) effect, (byte *) lump, buffer );
         break;
+    default:
+        ;
+    }
+}
+
+/*
+=================
+=
+= DrawCinematicEffect
+=
+=================
+*/
+boolean DrawCinematicEffect ( enum_eventtype type, void * effect )
+{
+    switch (type)
+    {
+    case background_noscrolling:
+    case background_scrolling:
+    case background_multi:
+    case backdrop_scrolling:
+    case backdrop_noscrolling:
     case sprite_background:
     case sprite_foreground:
-        DrawCinematicSprite ( (spriteevent *) effect );
+        RenderCinematicEffect ( type, effect,
+                                CacheCinematicEffect ( type, effect, PU_CACHE ),
+                                (byte *)bufferofs );
         return true;
         break;
     case flic:
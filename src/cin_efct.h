@@ -20,6 +20,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "cin_glob.h"
 #include "cin_def.h"
+#include "lumpy.h"
 
 flicevent * SpawnCinematicFlic ( char * name, boolean loop, boolean usefile );
 spriteevent * SpawnCinematicSprite ( char * name,
@@ -50,12 +51,16 @@ backevent * SpawnCinematicMultiBack ( char * name,
                                     );
 paletteevent * SpawnCinematicPalette ( char * name );
 void DrawFlic ( flicevent * flic );
-void DrawCinematicBackdrop ( backevent * back );
-void DrawCinematicBackground ( backevent * back );
+void RenderCinematicBackdrop ( backevent * back, byte * shape, byte * buffer );
+void RenderCinematicBackground ( backevent * back, lpic_t * pic, byte * buffer );
+void RenderCinematicMultiBackground ( backevent * back, byte * buffer );
 void DrawPalette (paletteevent * event);
-void DrawCinematicSprite ( spriteevent * sprite );
+void RenderCinematicSprite ( spriteevent * sprite, byte * shape, byte * buffer );
 void DrawClearBuffer ( void );
+void ClearCinematicBuffer ( byte * buffer );
 void DrawBlankScreen ( void );
+void * CacheCinematicEffect ( enum_eventtype type, void * effect, int tag );
+void RenderCinematicEffect ( enum_eventtype type, void * effect, void * lump, byte * buffer );
 boolean DrawCinematicEffect ( enum_eventtype type, void * effect );
 boolean UpdateCinematicBack ( backevent * back );
 boolean UpdateCinematicSprite ( spriteevent * sprite );
@@ -82,6 +82,7 @@ void StartupCinematic ( void )
     GetCinematicTics ();
     ClearCinematicAbort();
     ProfileMachine();
+    StartupCinematicFrames ();
 }
 
 
@@ -94,6 +95,7 @@ void StartupCinematic ( void )
 */
 void ShutdownCinematic ( void )
 {
+    ShutdownCinematicFrames ();
     ShutdownEvents ();
     ShutdownCinematicActors ();
 }
@@ -15,6 +15,15 @@
 #include <assert.h>
 
 #include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
 
 #define AL_ALEXT_PROTOTYPES 1
 #include <AL/al.h>
@@ -60,6 +69,32 @@ static int initialized_debugging = 0;
 static ALuint buffer, source;
 static ZMusic_MusicStream stream = nullptr;
 
+// Synthesis runs on its own thread RENDERAHEAD_MS ahead of playback; the
+// OpenAL callback only copies out of the ring.  musiclock serialises the
+// render thread against the control calls made by the game.
+#define RENDERAHEAD_MS  150
+#define RENDERCHUNK     4096
+
+#define MUSICRATE       44100
+#define SOUNDFONT       "./soundfont.sf2"
+
+static std::mutex musiclock;
+static std::thread renderthread;
+static std::atomic<bool> renderrunning(false);
+static std::atomic<bool> renderended(false);
+static unsigned char *ring = NULL;
+static size_t ringmask;
+static size_t ringahead;
+static unsigned char ringsilence;
+static std::atomic<size_t> ringwrite(0);
+static std::atomic<size_t> ringread(0);
+static std::atomic<unsigned long> underruns(0);
+static std::atomic<unsigned long> underrunbytes(0);
+
+// Time from MUSIC_PlaySong to the first sample being queued
+static int switchtime = 0;
+static int maxswitchtime = 0;
+
 // This gets called all over the place for information and debugging messages.
 //  If the user set the DUKESND_DEBUG environment variable, the messages
 //  go to the file that is specified in that variable. Otherwise, they
@@ -214,9 +249,9 @@ int MUSIC_Init(int SoundCard, int Address)
         array++;
     }
 
-    auto sfpath = std::filesystem::weakly_canonical("./soundfont.sf2").make_preferred();
+    auto sfpath = std::filesystem::weakly_canonical(SOUNDFONT).make_preferred();
     ChangeMusicSettingString(EStringConfigKey::zmusic_fluid_patchset, nullptr, sfpath.c_str());
-    ChangeMusicSettingInt(EIntConfigKey::zmusic_snd_outputrate, nullptr, 44100, nullptr);
+    ChangeMusicSettingInt(EIntConfigKey::zmusic_snd_outputrate, nullptr, MUSICRATE, nullptr);
     ChangeMusicSettingFloat(EFloatConfigKey::zmusic_fluid_gain, nullptr, 1, nullptr);
     ChangeMusicSettingFloat(EFloatConfigKey::zmusic_snd_mastervolume, nullptr, 1, nullptr);
     ChangeMusicSettingFloat(EFloatConfigKey::zmusic_snd_musicvolume, nullptr, 1, nullptr);
@@ -254,8 +289,491 @@ void MUSIC_SetMaxFMMidiChannel(int channel)
 
 float realvol = 1.f;
 
+// Song cache
+//
+// With MUSIC_PlaySongCached a song is synthesised once and kept as IMA
+// ADPCM (4:1 against 16 bit stereo) in a cache file.  Later plays decode
+// that on the render thread instead of running FluidSynth.  The file is
+// written while the first pass plays, or ahead of time by
+// MUSIC_RenderSongCache, and is only reused while the soundfont, output
+// rate and reverb/chorus settings it was made with stay the same.
+
+#define CACHEMAGIC      0x31434d52  // "RMC1"
+#define CACHEBLOCK      1024        // stereo frames per ADPCM block
+#define CACHEBLOCKBYTES (8 + CACHEBLOCK)
+#define MAXCACHEFRAMES  (MUSICRATE * 60 * 15)
+#define MAXCHUNKFRAMES  RENDERCHUNK
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t rate;
+    uint32_t sfsize;
+    uint32_t sfstamp;
+    uint32_t songcrc;
+    uint32_t settings;
+    uint32_t frames;
+} songcache_header;
+
+typedef struct
+{
+    int predictor;
+    int index;
+} adpcm_state;
+
+typedef struct
+{
+    FILE *file;
+    std::string name;
+    songcache_header header;
+    adpcm_state state[2];
+    short pcm[CACHEBLOCK * 2];
+    int count;
+} cache_writer;
+
+typedef struct
+{
+    FILE *file;
+    songcache_header header;
+    short pcm[CACHEBLOCK * 2];
+    int pos;
+    int count;
+    uint32_t framesleft;
+} cache_reader;
+
+static std::string songcachename;
+static songcache_header songid;
+static cache_writer *songwriter = NULL;
+static cache_reader *songreader = NULL;
+static bool songloop = false;
+static bool songrestart = false;   // live pass started unlooped for caching
+static std::atomic<bool> songpaused(false);
+
+// Format of the PCM in the ring, set by MUSIC_PlaySong
+static SampleType ringtype;
+static int ringchannels;
+static size_t ringframesize;
+
+static short convbuffer[MAXCHUNKFRAMES * 2];
+
+static const int adpcmindex[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int adpcmstep[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+    18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static void adpcm_advance(adpcm_state *state, int nibble, int delta)
+{
+    state->predictor += (nibble & 8) ? -delta : delta;
+    state->predictor = max(-32768, min(32767, state->predictor));
+    state->index = max(0, min(88, state->index + adpcmindex[nibble]));
+} // adpcm_advance
+
+static int adpcm_encode(adpcm_state *state, int sample)
+{
+    int step = adpcmstep[state->index];
+    int diff = sample - state->predictor;
+    int delta = step >> 3;
+    int nibble = 0;
+
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step)
+    {
+        nibble |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 1;
+        delta += step;
+    }
+    adpcm_advance(state, nibble, delta);
+    return nibble;
+} // adpcm_encode
+
+static int adpcm_decode(adpcm_state *state, int nibble)
+{
+    int step = adpcmstep[state->index];
+    int delta = step >> 3;
+
+    if (nibble & 4)
+        delta += step;
+    if (nibble & 2)
+        delta += step >> 1;
+    if (nibble & 1)
+        delta += step >> 2;
+    adpcm_advance(state, nibble, delta);
+    return state->predictor;
+} // adpcm_decode
+
+static size_t sample_bytes(SampleType type)
+{
+    switch (type)
+    {
+        case SampleType_Float32:
+            return 4;
+        case SampleType_Int16:
+            return 2;
+        default:
+            return 1;
+    }
+} // sample_bytes
+
+// Converts frames of the given format to 16 bit stereo.
+static void to_pcm16(const void *src, int frames, SampleType type, int channels, short *dst)
+{
+    int n = frames * channels;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int sample;
+
+        switch (type)
+        {
+            case SampleType_Float32:
+                sample = (int)(((const float *)src)[i] * 32767.f);
+                break;
+            case SampleType_UInt8:
+                sample = (((const unsigned char *)src)[i] - 128) << 8;
+                break;
+            default:
+                sample = ((const short *)src)[i];
+                break;
+        }
+        sample = max(-32768, min(32767, sample));
+        if (channels == 1)
+        {
+            dst[i * 2] = dst[i * 2 + 1] = (short)sample;
+        }
+        else
+        {
+            dst[i] = (short)sample;
+        }
+    }
+} // to_pcm16
+
+// Converts 16 bit stereo frames to the ring's format.
+static void from_pcm16(const short *src, int frames, void *dst)
+{
+    int n = frames * ringchannels;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int sample;
+
+        if (ringchannels == 1)
+            sample = (src[i * 2] + src[i * 2 + 1]) >> 1;
+        else
+            sample = src[i];
+
+        switch (ringtype)
+        {
+            case SampleType_Float32:
+                ((float *)dst)[i] = sample * (1.f / 32768.f);
+                break;
+            case SampleType_UInt8:
+                ((unsigned char *)dst)[i] = (unsigned char)((sample >> 8) + 128);
+                break;
+            default:
+                ((short *)dst)[i] = (short)sample;
+                break;
+        }
+    }
+} // from_pcm16
+
+// Fills in everything a cache file must match to be reused.
+static void cache_identity(songcache_header *header, const char *song, int size)
+{
+    struct stat sf;
+    uint32_t crc = 2166136261u;
+    int i;
+
+    memset(header, 0, sizeof(*header));
+    header->magic = CACHEMAGIC;
+    header->rate = MUSICRATE;
+    if (stat(SOUNDFONT, &sf) == 0)
+    {
+        header->sfsize = (uint32_t)sf.st_size;
+        header->sfstamp = (uint32_t)sf.st_mtime;
+    }
+    for (i = 0; i < size; i++)
+        crc = (crc ^ (unsigned char)song[i]) * 16777619u;
+    header->songcrc = crc;
+    header->settings = (reverbMusic ? 1 : 0) | (chorusMusic ? 2 : 0);
+} // cache_identity
+
+static cache_writer *open_cache_writer(const char *name, const songcache_header *id)
+{
+    cache_writer *writer = new cache_writer();
+
+    writer->name = name;
+    writer->name += ".tmp";
+    writer->file = fopen(writer->name.c_str(), "wb");
+    if (writer->file == NULL)
+    {
+        musdebug("Could not create song cache %s.", writer->name.c_str());
+        delete writer;
+        return NULL;
+    }
+    writer->header = *id;
+    fwrite(&writer->header, sizeof(writer->header), 1, writer->file);
+    return writer;
+} // open_cache_writer
+
+static void abort_cache_writer(cache_writer *writer)
+{
+    fclose(writer->file);
+    remove(writer->name.c_str());
+    delete writer;
+} // abort_cache_writer
+
+static void write_cache_block(cache_writer *writer)
+{
+    unsigned char block[CACHEBLOCKBYTES];
+    unsigned char *out = block;
+    int c, i;
+
+    // Pad the last block, the header frame count says where the song ends
+    memset(writer->pcm + writer->count * 2, 0,
+           (CACHEBLOCK - writer->count) * 2 * sizeof(short));
+
+    for (c = 0; c < 2; c++)
+    {
+        *out++ = (unsigned char)(writer->state[c].predictor & 0xff);
+        *out++ = (unsigned char)((writer->state[c].predictor >> 8) & 0xff);
+        *out++ = (unsigned char)writer->state[c].index;
+        *out++ = 0;
+    }
+    for (i = 0; i < CACHEBLOCK; i++)
+    {
+        *out++ = (unsigned char)(adpcm_encode(&writer->state[0], writer->pcm[i * 2]) |
+                                 (adpcm_encode(&writer->state[1], writer->pcm[i * 2 + 1]) << 4));
+    }
+    fwrite(block, sizeof(block), 1, writer->file);
+    writer->header.frames += writer->count;
+    writer->count = 0;
+} // write_cache_block
+
+// Adds 16 bit stereo frames, false if the song has grown too long to cache.
+static bool write_cache_frames(cache_writer *writer, const short *pcm, int frames)
+{
+    while (frames > 0)
+    {
+        int n = min(frames, CACHEBLOCK - writer->count);
+
+        memcpy(writer->pcm + writer->count * 2, pcm, n * 2 * sizeof(short));
+        writer->count += n;
+        pcm += n * 2;
+        frames -= n;
+        if (writer->count == CACHEBLOCK)
+            write_cache_block(writer);
+    }
+    return writer->header.frames < MAXCACHEFRAMES;
+} // write_cache_frames
+
+// Completes the file and moves it into place.
+static bool close_cache_writer(cache_writer *writer, const char *name)
+{
+    bool ok;
+
+    if (writer->count > 0)
+        write_cache_block(writer);
+
+    fseek(writer->file, 0, SEEK_SET);
+    fwrite(&writer->header, sizeof(writer->header), 1, writer->file);
+    ok = (ferror(writer->file) == 0) && (writer->header.frames > 0);
+    fclose(writer->file);
+
+    remove(name);
+    if (ok)
+        ok = (rename(writer->name.c_str(), name) == 0);
+    if (!ok)
+        remove(writer->name.c_str());
+    else
+        musdebug("Cached %u frames in %s.", (unsigned)writer->header.frames, name);
+    delete writer;
+    return ok;
+} // close_cache_writer
+
+static void rewind_cache_reader(cache_reader *reader)
+{
+    fseek(reader->file, sizeof(songcache_header), SEEK_SET);
+    reader->framesleft = reader->header.frames;
+    reader->pos = reader->count = 0;
+} // rewind_cache_reader
+
+static cache_reader *open_cache_reader(const char *name, const songcache_header *id)
+{
+    cache_reader *reader;
+    FILE *file = fopen(name, "rb");
+
+    if (file == NULL)
+        return NULL;
+
+    reader = new cache_reader();
+    reader->file = file;
+    if ((fread(&reader->header, sizeof(reader->header), 1, file) != 1) ||
+        (reader->header.frames == 0) ||
+        memcmp(&reader->header, id, offsetof(songcache_header, frames)))
+    {
+        musdebug("Song cache %s is stale.", name);
+        fclose(file);
+        delete reader;
+        return NULL;
+    }
+    rewind_cache_reader(reader);
+    return reader;
+} // open_cache_reader
+
+static void close_cache_reader(cache_reader *reader)
+{
+    fclose(reader->file);
+    delete reader;
+} // close_cache_reader
+
+static bool read_cache_block(cache_reader *reader)
+{
+    unsigned char block[CACHEBLOCKBYTES];
+    unsigned char *in = block + 8;
+    adpcm_state state[2];
+    int c, i;
+
+    if ((reader->framesleft == 0) ||
+        (fread(block, sizeof(block), 1, reader->file) != 1))
+        return false;
+
+    for (c = 0; c < 2; c++)
+    {
+        state[c].predictor = (short)(block[c * 4] | (block[c * 4 + 1] << 8));
+        state[c].index = min((int)block[c * 4 + 2], 88);
+    }
+    reader->count = (int)min((uint32_t)CACHEBLOCK, reader->framesleft);
+    for (i = 0; i < reader->count; i++, in++)
+    {
+        reader->pcm[i * 2] = (short)adpcm_decode(&state[0], *in & 0xf);
+        reader->pcm[i * 2 + 1] = (short)adpcm_decode(&state[1], *in >> 4);
+    }
+    reader->framesleft -= reader->count;
+    reader->pos = 0;
+    return true;
+} // read_cache_block
+
+// Decodes up to frames 16 bit stereo frames, returns how many it got.
+static int read_cache_frames(cache_reader *reader, short *pcm, int frames)
+{
+    int got = 0;
+
+    while (got < frames)
+    {
+        int n;
+
+        if ((reader->pos == reader->count) && !read_cache_block(reader))
+            break;
+        n = min(frames - got, reader->count - reader->pos);
+        memcpy(pcm + got * 2, reader->pcm + reader->pos * 2, n * 2 * sizeof(short));
+        reader->pos += n;
+        got += n;
+    }
+    return got;
+} // read_cache_frames
+
+// Fills one ring chunk from the cache, false at the end of a song that
+// does not loop.
+static bool render_cache_chunk(unsigned char *dst)
+{
+    int frames = (int)(RENDERCHUNK / ringframesize);
+    int got = 0;
+
+    if (songpaused)
+    {
+        memset(dst, ringsilence, RENDERCHUNK);
+        return true;
+    }
+
+    while (got < frames)
+    {
+        int n = read_cache_frames(songreader, convbuffer + got * 2, frames - got);
+
+        if (n == 0)
+        {
+            if (!songloop)
+                break;
+            rewind_cache_reader(songreader);
+            n = read_cache_frames(songreader, convbuffer + got * 2, frames - got);
+            if (n == 0)
+                break;
+        }
+        got += n;
+    }
+
+    if (got == 0)
+        return false;
+
+    memset(convbuffer + got * 2, 0, (frames - got) * 2 * sizeof(short));
+    from_pcm16(convbuffer, frames, dst);
+    return true;
+} // render_cache_chunk
+
+// The first pass of a cached song has been synthesised; finish the cache
+// and carry on from it if the song loops.
+static bool finish_song_cache(void)
+{
+    bool ok = close_cache_writer(songwriter, songcachename.c_str());
+
+    songwriter = NULL;
+    if (!ok || !songloop)
+        return false;
+
+    songreader = open_cache_reader(songcachename.c_str(), &songid);
+    return songreader != NULL;
+} // finish_song_cache
+
+
+// Live synthesis applies the music volume inside ZMusic as well as on the
+// source.  Cached PCM is made at full volume, so both shares go on the source.
+static float source_gain(void)
+{
+    if ((songwriter != NULL) || (songreader != NULL))
+        return realvol * realvol;
+    return realvol;
+} // source_gain
+
+
 void MUSIC_SetVolume(int volume)
 {
+    std::lock_guard<std::mutex> lock(musiclock);
+    if ((songwriter != NULL) || (songreader != NULL))
+    {
+        realvol = (float)volume / 255.f;
+        alSourcef(source, AL_GAIN, source_gain());
+        return;
+    }
     ChangeMusicSettingFloat(EFloatConfigKey::zmusic_snd_musicvolume, stream, (float)volume / 255.f, &realvol);
     ZMusic_VolumeChanged(stream);
     alSourcef(source, AL_GAIN, (float)volume / 255.f);
@@ -287,41 +805,200 @@ void MUSIC_SetLoopFlag(int loopflag)
 
 int MUSIC_SongPlaying(void)
 {
+    // The render thread can finish a song well before it is heard
+    if (renderended && (ringread == ringwrite))
+        return __FX_FALSE;
+
+    std::lock_guard<std::mutex> lock(musiclock);
+    if (songreader != NULL)
+        return __FX_TRUE;
+    if (stream == nullptr)
+        return __FX_FALSE;
     return ZMusic_IsPlaying(stream);
 } // MUSIC_SongPlaying
 
 
 void MUSIC_Continue(void)
 {
-    if (stream && ZMusic_IsPlaying(stream))
-        ZMusic_Resume(stream);
-    else if (music_songdata)
+    bool playing = false;
+
+    {
+        std::lock_guard<std::mutex> lock(musiclock);
+        songpaused = false;
+        if (songreader != NULL)
+            playing = true;
+        else if (stream)
+        {
+            playing = ZMusic_IsPlaying(stream);
+            if (playing)
+                ZMusic_Resume(stream);
+        }
+    }
+    if (!playing && music_songdata)
         MUSIC_PlaySong(music_songdata, MUSIC_PlayOnce);
 
-    alSourcef(source, AL_GAIN, realvol);
+    std::lock_guard<std::mutex> lock(musiclock);
+    alSourcef(source, AL_GAIN, source_gain());
 } // MUSIC_Continue
 
 
 void MUSIC_Pause(void)
 {
-    ZMusic_Pause(stream);
+    {
+        std::lock_guard<std::mutex> lock(musiclock);
+        songpaused = true;
+        if (stream)
+            ZMusic_Pause(stream);
+    }
     alSourcef(source, AL_GAIN, 0);
 } // MUSIC_Pause
 
 
+unsigned long MUSIC_GetUnderruns(unsigned long *bytes)
+{
+    if (bytes != NULL)
+        *bytes = underrunbytes;
+    return underruns;
+} // MUSIC_GetUnderruns
+
+
+// Renders one chunk into the ring, returns false once the song is over.
+static bool render_chunk(void)
+{
+    size_t write = ringwrite.load(std::memory_order_relaxed);
+    // RENDERCHUNK divides the ring size, so a chunk never wraps
+    unsigned char *dst = ring + (write & ringmask);
+    std::lock_guard<std::mutex> lock(musiclock);
+
+    if (songreader == NULL)
+    {
+        ZMusic_Update(stream);
+        if (!ZMusic_IsPlaying(stream))
+        {
+            if ((songwriter == NULL) || !finish_song_cache())
+            {
+                if (!songrestart)
+                    return false;
+
+                // Caching failed, keep looping live
+                songrestart = false;
+                ZMusic_Start(stream, 0, true);
+            }
+        }
+    }
+
+    if (songreader != NULL)
+    {
+        if (!render_cache_chunk(dst))
+            return false;
+    }
+    else
+    {
+        ZMusic_FillStream(stream, dst, RENDERCHUNK);
+        if ((songwriter != NULL) && !songpaused)
+        {
+            int frames = (int)(RENDERCHUNK / ringframesize);
+
+            to_pcm16(dst, frames, ringtype, ringchannels, convbuffer);
+            if (!write_cache_frames(songwriter, convbuffer, frames))
+            {
+                musdebug("Song too long to cache.");
+                abort_cache_writer(songwriter);
+                songwriter = NULL;
+            }
+        }
+    }
+
+    ringwrite.store(write + RENDERCHUNK, std::memory_order_release);
+    return true;
+} // render_chunk
+
+
+static void render_ahead(void)
+{
+    while (renderrunning)
+    {
+        if (ringwrite.load(std::memory_order_relaxed) -
+            ringread.load(std::memory_order_acquire) >= ringahead)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        if (!render_chunk())
+        {
+            renderended = true;
+            break;
+        }
+    }
+} // render_ahead
+
+
+static ALsizei AL_APIENTRY play_ring(ALvoid *userptr, ALvoid *sampledata, ALsizei numbytes)
+{
+    size_t read = ringread.load(std::memory_order_relaxed);
+    size_t avail = ringwrite.load(std::memory_order_acquire) - read;
+    size_t count = min((size_t)numbytes, avail);
+    size_t offset = read & ringmask;
+    size_t first = min(count, ringmask + 1 - offset);
+
+    memcpy(sampledata, ring + offset, first);
+    memcpy((unsigned char *)sampledata + first, ring, count - first);
+    ringread.store(read + count, std::memory_order_release);
+
+    if (count < (size_t)numbytes)
+    {
+        if (renderended)
+            return (ALsizei)count;
+
+        // Render thread fell behind, pad with silence rather than stall
+        memset((unsigned char *)sampledata + count, ringsilence, numbytes - count);
+        underruns++;
+        underrunbytes += numbytes - count;
+    }
+    return numbytes;
+} // play_ring
+
+
+static void stop_render_thread(void)
+{
+    renderrunning = false;
+    if (renderthread.joinable())
+        renderthread.join();
+} // stop_render_thread
+
+
 int MUSIC_StopSong(void)
 {
-    if (stream)
+    if (stream || songreader)
     {
-        ZMusic_Resume(stream);
         alSourceStop(source);
         alSourcei(source, AL_BUFFER, 0);
         alSourcef(source, AL_GAIN, 0);
-        ZMusic_Stop(stream);
-        ZMusic_Close(stream);
-        stream = nullptr;
+        stop_render_thread();
+        if (songwriter != NULL)
+        {
+            abort_cache_writer(songwriter);
+            songwriter = NULL;
+        }
+        if (songreader != NULL)
+        {
+            close_cache_reader(songreader);
+            songreader = NULL;
+        }
+        if (stream)
+        {
+            ZMusic_Resume(stream);
+            ZMusic_Stop(stream);
+            ZMusic_Close(stream);
+            stream = nullptr;
+        }
         music_songdata = NULL;
         music_size = 0;
+        free(ring);
+        ring = NULL;
+        if (underruns)
+            musdebug("%lu music underruns so far, %lu bytes of silence.",
+                     (unsigned long)underruns, (unsigned long)underrunbytes);
     }
     return(MUSIC_Ok);
 } // MUSIC_StopSong
@@ -412,60 +1089,144 @@ void close_data(ZMusicCustomReader* zr)
     delete zr;
 }
 
+static ZMusicCustomReader* open_memory_reader(char *data, int size)
+{
+    auto zcr = new ZMusicCustomReader;
+    zcr->handle = new memory_file{0, size, data};
+    zcr->gets = gets_data;
+    zcr->close = close_data;
+    zcr->read = read_data;
+    zcr->tell = get_tell;
+    zcr->seek = seek_data;
+    return zcr;
+}
+
+static int elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+
+int MUSIC_GetSwitchTime(int *maxtime)
+{
+    if (maxtime != NULL)
+        *maxtime = maxswitchtime;
+    return switchtime;
+} // MUSIC_GetSwitchTime
+
 int MUSIC_PlaySong(char *song, int loopflag)
 {
     SoundStreamInfoEx info;
-    
-    auto callback = [](ALvoid *userptr, ALvoid *sampledata, ALsizei numbytes) -> int
-            {
-                ZMusic_MusicStream musStream = stream;
-
-                ZMusic_Update(musStream);
-                if (!ZMusic_IsPlaying(musStream))
-                    return 0;
-                ZMusic_FillStream(musStream, sampledata, numbytes);
-                return numbytes;
-            };
+    ALenum format = AL_NONE;
+    size_t ahead;
+    int size = music_size;
+    auto start = std::chrono::steady_clock::now();
 
     MUSIC_StopSong();
 
     music_songdata = song;
+    music_size = size;
     music_loopflag = loopflag;
+    songloop = (loopflag != MUSIC_PlayOnce);
+    songrestart = false;
+    songpaused = false;
 
-    auto zcr = new ZMusicCustomReader;
-    zcr->handle = new memory_file{0, music_size, (char*)song};
-    zcr->gets = gets_data;
-    zcr->close = close_data;
-    zcr->read = read_data;
-    zcr->tell = get_tell;
-    zcr->seek = seek_data;
+    if (!songcachename.empty())
+    {
+        cache_identity(&songid, song, size);
+        songreader = open_cache_reader(songcachename.c_str(), &songid);
+    }
+
+    if (songreader != NULL)
+    {
+        info.mSampleRate = songreader->header.rate;
+        info.mSampleType = SampleType_Int16;
+        info.mChannelConfig = ChannelConfig_Stereo;
+    }
+    else
+    {
+        //player = new_fluid_player(synth);
+        //audiodrv = new_fluid_audio_driver(settings, synth);
+        if ((stream = ZMusic_OpenSong(open_memory_reader(song, size), EMidiDevice::MDEV_FLUIDSYNTH, "")) == nullptr) {
+            printf("Failed to open music!\n");
+            return MUSIC_Error;
+        }
 
-    //player = new_fluid_player(synth);
-    //audiodrv = new_fluid_audio_driver(settings, synth);
-    if ((stream = ZMusic_OpenSong(zcr, EMidiDevice::MDEV_FLUIDSYNTH, "")) == nullptr) {
-        printf("Failed to open music!\n");
-        return MUSIC_Error;
+        // The first pass is played unlooped so its end can close the cache
+        if (!songcachename.empty())
+            songwriter = open_cache_writer(songcachename.c_str(), &songid);
+        if (songwriter != NULL)
+        {
+            ChangeMusicSettingFloat(EFloatConfigKey::zmusic_snd_musicvolume, stream, 1, nullptr);
+            songrestart = songloop;
+        }
+
+        ZMusic_Start(stream, 0, songloop && !songrestart);
+        ZMusic_GetStreamInfoEx(stream, &info);
+        if ((songwriter != NULL) && ((uint32_t)info.mSampleRate != songid.rate))
+        {
+            abort_cache_writer(songwriter);
+            songwriter = NULL;
+        }
     }
 
-    ZMusic_Start(stream, 0, music_loopflag != MUSIC_PlayOnce);
-    ZMusic_GetStreamInfoEx(stream, &info);
+    ringtype = info.mSampleType;
+    ringchannels = (info.mChannelConfig == ChannelConfig_Stereo) ? 2 : 1;
+    ringframesize = sample_bytes(ringtype) * ringchannels;
+    ringsilence = (ringtype == SampleType_UInt8) ? 0x80 : 0;
     switch (info.mSampleType)
     {
         case SampleType_Float32:
-            alBufferCallbackSOFT(buffer, info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO_FLOAT32 : AL_FORMAT_MONO_FLOAT32, info.mSampleRate, callback, stream);
+            format = info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO_FLOAT32 : AL_FORMAT_MONO_FLOAT32;
             break;
         case SampleType_Int16:
-            alBufferCallbackSOFT(buffer, info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16, info.mSampleRate, callback, stream);
+            format = info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
             break;
         case SampleType_UInt8:
-            alBufferCallbackSOFT(buffer, info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO8 : AL_FORMAT_MONO8, info.mSampleRate, callback, stream);
+            format = info.mChannelConfig == ChannelConfig_Stereo ? AL_FORMAT_STEREO8 : AL_FORMAT_MONO8;
             break;
     }
 
-    alSourcef(source, AL_GAIN, realvol);
+    // Round the render-ahead window up to whole chunks, the ring holds twice that
+    ahead = (size_t)info.mSampleRate * ringframesize * RENDERAHEAD_MS / 1000;
+    ahead = (ahead + RENDERCHUNK - 1) & ~(size_t)(RENDERCHUNK - 1);
+    ringmask = RENDERCHUNK;
+    while (ringmask < ahead * 2)
+        ringmask <<= 1;
+    ring = (unsigned char *)malloc(ringmask);
+    ringmask--;
+    ringahead = ahead;
+    ringread = 0;
+    ringwrite = 0;
+    renderended = false;
+
+    // Prime the ring so playback starts without an underrun
+    while (ringwrite < ringahead)
+    {
+        if (!render_chunk())
+        {
+            renderended = true;
+            break;
+        }
+    }
+
+    if (!renderended)
+    {
+        renderrunning = true;
+        renderthread = std::thread(render_ahead);
+    }
+
+    alBufferCallbackSOFT(buffer, format, info.mSampleRate, play_ring, NULL);
+
+    alSourcef(source, AL_GAIN, source_gain());
     alSourcei(source, AL_BUFFER, buffer);
     alSourcePlay(source);
 
+    switchtime = elapsed_ms(start);
+    maxswitchtime = max(maxswitchtime, switchtime);
+    musdebug("Song switch took %d ms.", switchtime);
+
     return(MUSIC_Ok);
 } // MUSIC_PlaySong
 
@@ -474,8 +1235,85 @@ int MUSIC_PlaySong(char *song, int loopflag)
 int MUSIC_PlaySongROTT(char *song, int size, int loopflag)
 {
     music_size = size;
+    songcachename.clear();
     return MUSIC_PlaySong(song, loopflag);
 } // MUSIC_PlaySongROTT
+
+
+int MUSIC_PlaySongCached(char *song, int size, int loopflag, const char *cachename)
+{
+    music_size = size;
+    songcachename = cachename;
+    return MUSIC_PlaySong(song, loopflag);
+} // MUSIC_PlaySongCached
+
+
+int MUSIC_RenderSongCache(char *song, int size, const char *cachename)
+{
+    songcache_header id;
+    SoundStreamInfoEx info;
+    ZMusic_MusicStream render;
+    cache_reader *reader;
+    cache_writer *writer;
+    std::vector<unsigned char> chunk(RENDERCHUNK);
+    std::vector<short> pcm(MAXCHUNKFRAMES * 2);
+    int frames;
+    bool ok = true;
+
+    cache_identity(&id, song, size);
+    if ((reader = open_cache_reader(cachename, &id)) != NULL)
+    {
+        close_cache_reader(reader);
+        return(MUSIC_Ok);
+    }
+
+    render = ZMusic_OpenSong(open_memory_reader(song, size), EMidiDevice::MDEV_FLUIDSYNTH, "");
+    if (render == nullptr)
+    {
+        setErrorMessage("Failed to open music.");
+        return(MUSIC_Error);
+    }
+    if ((writer = open_cache_writer(cachename, &id)) == NULL)
+    {
+        ZMusic_Close(render);
+        setErrorMessage("Could not create song cache.");
+        return(MUSIC_Error);
+    }
+
+    ChangeMusicSettingFloat(EFloatConfigKey::zmusic_snd_musicvolume, render, 1, nullptr);
+    ZMusic_Start(render, 0, false);
+    ZMusic_GetStreamInfoEx(render, &info);
+    frames = (int)(RENDERCHUNK / (sample_bytes(info.mSampleType) *
+                                  ((info.mChannelConfig == ChannelConfig_Stereo) ? 2 : 1)));
+    if ((uint32_t)info.mSampleRate != id.rate)
+        ok = false;
+
+    while (ok)
+    {
+        ZMusic_Update(render);
+        if (!ZMusic_IsPlaying(render))
+            break;
+        ZMusic_FillStream(render, chunk.data(), RENDERCHUNK);
+        to_pcm16(chunk.data(), frames, info.mSampleType,
+                 (info.mChannelConfig == ChannelConfig_Stereo) ? 2 : 1, pcm.data());
+        ok = write_cache_frames(writer, pcm.data(), frames);
+    }
+    ZMusic_Stop(render);
+    ZMusic_Close(render);
+
+    if (!ok)
+    {
+        abort_cache_writer(writer);
+        setErrorMessage("Song could not be cached.");
+        return(MUSIC_Error);
+    }
+    if (!close_cache_writer(writer, cachename))
+    {
+        setErrorMessage("Could not write song cache.");
+        return(MUSIC_Error);
+    }
+    return(MUSIC_Ok);
+} // MUSIC_RenderSongCache
 #endif
 
 
@@ -556,6 +1394,7 @@ void MUSIC_RegisterTimbreBank(unsigned char *timbres)
 
 void MUSIC_UpdateReverbChorus( void )
 {
+    std::lock_guard<std::mutex> lock(musiclock);
     ChangeMusicSettingInt(EIntConfigKey::zmusic_fluid_reverb, stream, reverbMusic, nullptr);
     ChangeMusicSettingInt(EIntConfigKey::zmusic_fluid_chorus, stream, chorusMusic, nullptr);
 }
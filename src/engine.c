@@ -25,6 +25,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "rt_ted.h"
 #include "rt_view.h"
 #include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 /*
@@ -50,8 +53,37 @@ Local Variables
 static int xtilestep,ytilestep;
 static int c_vx,c_vy;
 
-void InitialCast ( void );
-void Cast ( int curx );
+//
+// Rays are walked CASTLANES at a time in lockstep.  A ray never marks
+// spotvis directly while it is walked, it keeps the spots it passed in
+// its trail, and the trails are applied afterwards in the same order the
+// old one-ray-at-a-time caster visited them, so visiblespots and
+// everything gathered from it come out identical.
+//
+
+#define CASTLANES     4
+#define RAYTRAILSIZE  ((MAPSIZE*2)+4)   // a ray crosses at most 2*MAPSIZE tiles
+#define RAYWIDEDOOR   0x8000            // trail entry for MakeWideDoorVisible
+
+typedef struct
+{
+    int   curx;
+    int   cnt;
+    int   incr[2];
+    int   thedir[2];
+    int   grid[2];
+    int   index;
+    int   xtilestep;
+    int   ytilestep;
+    int   c_vx;
+    int   c_vy;
+    int   traillength;
+    word  trail[RAYTRAILSIZE];
+} ray_t;
+
+static ray_t combrays[CASTLANES];
+static ray_t centerrays[CASTLANES];
+static ray_t siderays[CASTLANES*2];
 
 void Interpolate (int x1, int x2)
 {
@@ -78,38 +110,6 @@ void Interpolate (int x1, int x2)
     }
 }
 
-void Refresh ( void )
-{
-    int x;
-
-// Cast Initial comb filter
-
-    InitialCast();
-
-    for (x=0; x<=viewwidth-4; x+=4)
-    {
-        if NOTSAMETILE(x,x+4)
-        {
-            Cast(x+2);
-            if NOTSAMETILE(x,x+2)
-            {
-                Cast(x+1);
-            }
-            else
-                Interpolate (x,x+2);
-            if NOTSAMETILE(x+2,x+4)
-            {
-                Cast(x+3);
-            }
-            else
-                Interpolate (x+2,x+4);
-        }
-        else
-            Interpolate(x,x+4);
-    }
-}
-
-
 void HitWall(int curx, int vertical, int xtile, int ytile)
 {
     int num;
@@ -232,184 +232,381 @@ void HitWall(int curx, int vertical, int xtile, int ytile)
     posts[curx].wallheight=CalcHeight();
 }
 
-void InitialCast ( void )
+
+//******************************************************************************
+//
+// SetupRay ()
+//
+//******************************************************************************
+
+static void SetupRay ( ray_t * ray, int curx )
 {
     int snx,sny;
-    int incr[2];
-    int thedir[2];
-    int cnt;
-    int grid[2];
-    int index;
-    int curx;
-
-    c_vx=c_startx;
-    c_vy=c_starty;
-    for (curx=0; curx<=viewwidth; curx+=4)
+
+    ray->curx=curx;
+    ray->c_vx=c_startx+(curx*viewsin);
+    ray->c_vy=c_starty+(curx*viewcos);
+    ray->traillength=0;
+    snx=viewx&0xffff;
+    sny=viewy&0xffff;
+
+    if (ray->c_vx>0)
+    {
+        ray->thedir[0]=1;
+        ray->xtilestep=0x80;
+        snx^=0xffff;
+        ray->incr[1]=-ray->c_vx;
+    }
+    else
+    {
+        ray->thedir[0]=-1;
+        ray->xtilestep=-0x80;
+        ray->incr[1]=ray->c_vx;
+    }
+    if (ray->c_vy>0)
+    {
+        ray->thedir[1]=1;
+        ray->ytilestep=1;
+        sny^=0xffff;
+        ray->incr[0]=ray->c_vy;
+    }
+    else
     {
-        snx=viewx&0xffff;
-        sny=viewy&0xffff;
+        ray->thedir[1]=-1;
+        ray->ytilestep=-1;
+        ray->incr[0]=-ray->c_vy;
+    }
+    ray->cnt=FixedMul(snx,ray->incr[0])+FixedMul(sny,ray->incr[1]);
+    ray->grid[0]=viewx>>16;
+    ray->grid[1]=viewy>>16;
+    ray->index=0;
+}
 
-        if (c_vx>0)
-        {
-            thedir[0]=1;
-            xtilestep=0x80;
-            snx^=0xffff;
-            incr[1]=-c_vx;
-        }
-        else
+//******************************************************************************
+//
+// MarkRaySpot ()
+//
+// Spots already in spotvis are skipped, spotvis only grows during a refresh
+// so marking them again later would not change anything
+//
+//******************************************************************************
+
+static void MarkRaySpot ( ray_t * ray, int x, int y )
+{
+    if (!spotvis[x][y])
+        ray->trail[ray->traillength++]=(x*MAPSIZE)+y;
+}
+
+//******************************************************************************
+//
+// RayHitsTile ()
+//
+// Looks at the tile the ray just stepped into, returns true once the ray
+// has found the wall it stops at.  Closed doors are walked through here.
+//
+//******************************************************************************
+
+static boolean RayHitsTile ( ray_t * ray )
+{
+    int tile;
+
+    tile=tilemap[ray->grid[0]][ray->grid[1]];
+    if (tile==0)
+        return false;
+
+    if (tile&0x8000)
+    {
+        if ( (!(tile&0x4000)) && (doorobjlist[tile&0x3ff]->action==dr_closed))
         {
-            thedir[0]=-1;
-            xtilestep=-0x80;
-            incr[1]=c_vx;
+            MarkRaySpot(ray,ray->grid[0],ray->grid[1]);
+            if (doorobjlist[tile&0x3ff]->flags&DF_MULTI)
+                ray->trail[ray->traillength++]=RAYWIDEDOOR|(tile&0x3ff);
+            do
+            {
+                ray->index=(ray->cnt>=0);
+                ray->cnt+=ray->incr[ray->index];
+                ray->grid[ray->index]+=ray->thedir[ray->index];
+                tile=tilemap[ray->grid[0]][ray->grid[1]];
+                if ((tile!=0) && (!(tile&0x8000)))
+                    break;
+            }
+            while (1);
+            return true;
         }
-        if (c_vy>0)
+        return false;
+    }
+
+    mapseen[ray->grid[0]][ray->grid[1]]=1;
+    return true;
+}
+
+//******************************************************************************
+//
+// WalkRay ()
+//
+// Scalar walk, used for the rest of a ray once it meets a door or a
+// masked wall
+//
+//******************************************************************************
+
+static void WalkRay ( ray_t * ray )
+{
+    do
+    {
+        ray->index=(ray->cnt>=0);
+        ray->cnt+=ray->incr[ray->index];
+        MarkRaySpot(ray,ray->grid[0],ray->grid[1]);
+        ray->grid[ray->index]+=ray->thedir[ray->index];
+    }
+    while (RayHitsTile(ray)==false);
+}
+
+//******************************************************************************
+//
+// WalkLanes ()
+//
+// Steps up to CASTLANES rays together.  The DDA step is done for all lanes
+// at once, only the tilemap fetch is per lane.  Lanes that step onto a
+// door or masked wall drop out to WalkRay.
+//
+//******************************************************************************
+
+static void WalkLanes ( ray_t * rays, int numrays )
+{
+    int cnt[CASTLANES];
+    int incr[2][CASTLANES];
+    int dir[2][CASTLANES];
+    int grid[2][CASTLANES];
+    int oldgrid[2][CASTLANES];
+    int index[CASTLANES];
+    int active[CASTLANES];
+    int numactive;
+    int i;
+    ray_t * ray;
+#ifdef __SSE2__
+    __m128i vcnt,vincr0,vincr1,vdir0,vdir1,vgrid0,vgrid1,vactive;
+    __m128i sel0,sel1;
+    const __m128i vminus1 = _mm_set1_epi32(-1);
+#endif
+
+    for (i=0; i<CASTLANES; i++)
+    {
+        if (i<numrays)
         {
-            thedir[1]=1;
-            ytilestep=1;
-            sny^=0xffff;
-            incr[0]=c_vy;
+            ray=&rays[i];
+            cnt[i]=ray->cnt;
+            incr[0][i]=ray->incr[0];
+            incr[1][i]=ray->incr[1];
+            dir[0][i]=ray->thedir[0];
+            dir[1][i]=ray->thedir[1];
+            grid[0][i]=ray->grid[0];
+            grid[1][i]=ray->grid[1];
+            active[i]=-1;
         }
         else
         {
-            thedir[1]=-1;
-            ytilestep=-1;
-            incr[0]=-c_vy;
+            cnt[i]=0;
+            incr[0][i]=incr[1][i]=0;
+            dir[0][i]=dir[1][i]=0;
+            grid[0][i]=grid[1][i]=0;
+            active[i]=0;
         }
-        cnt=FixedMul(snx,incr[0])+FixedMul(sny,incr[1]);
-        grid[0]=viewx>>16;
-        grid[1]=viewy>>16;
-        do
+    }
+    numactive=numrays;
+
+#ifdef __SSE2__
+    vcnt=_mm_loadu_si128((__m128i *)cnt);
+    vincr0=_mm_loadu_si128((__m128i *)incr[0]);
+    vincr1=_mm_loadu_si128((__m128i *)incr[1]);
+    vdir0=_mm_loadu_si128((__m128i *)dir[0]);
+    vdir1=_mm_loadu_si128((__m128i *)dir[1]);
+    vgrid0=_mm_loadu_si128((__m128i *)grid[0]);
+    vgrid1=_mm_loadu_si128((__m128i *)grid[1]);
+    vactive=_mm_loadu_si128((__m128i *)active);
+#endif
+
+    while (numactive>0)
+    {
+#ifdef __SSE2__
+        _mm_storeu_si128((__m128i *)oldgrid[0],vgrid0);
+        _mm_storeu_si128((__m128i *)oldgrid[1],vgrid1);
+
+        // lanes with cnt>=0 step in y, the others in x
+
+        sel1=_mm_and_si128(_mm_cmpgt_epi32(vcnt,vminus1),vactive);
+        sel0=_mm_andnot_si128(sel1,vactive);
+        vcnt=_mm_add_epi32(vcnt,_mm_or_si128(_mm_and_si128(sel0,vincr0),
+                                             _mm_and_si128(sel1,vincr1)));
+        vgrid0=_mm_add_epi32(vgrid0,_mm_and_si128(sel0,vdir0));
+        vgrid1=_mm_add_epi32(vgrid1,_mm_and_si128(sel1,vdir1));
+
+        _mm_storeu_si128((__m128i *)cnt,vcnt);
+        _mm_storeu_si128((__m128i *)grid[0],vgrid0);
+        _mm_storeu_si128((__m128i *)grid[1],vgrid1);
+        _mm_storeu_si128((__m128i *)index,sel1);
+#else
+        for (i=0; i<numrays; i++)
         {
-            int tile;
-
-            index=(cnt>=0);
-            cnt+=incr[index];
-            spotvis[grid[0]][grid[1]]=1;
-            grid[index]+=thedir[index];
+            if (!active[i])
+                continue;
+            oldgrid[0][i]=grid[0][i];
+            oldgrid[1][i]=grid[1][i];
+            index[i]=(cnt[i]>=0);
+            cnt[i]+=incr[index[i]][i];
+            grid[index[i]][i]+=dir[index[i]][i];
+        }
+#endif
 
-            if ((tile=tilemap[grid[0]][grid[1]])!=0)
-            {
-                if (tile&0x8000)
-                {
-                    if ( (!(tile&0x4000)) && (doorobjlist[tile&0x3ff]->action==dr_closed))
-                    {
-                        spotvis[grid[0]][grid[1]]=1;
-                        if (doorobjlist[tile&0x3ff]->flags&DF_MULTI)
-                            MakeWideDoorVisible(tile&0x3ff);
-                        do
-                        {
-                            index=(cnt>=0);
-                            cnt+=incr[index];
-                            grid[index]+=thedir[index];
-                            if ((tilemap[grid[0]][grid[1]]!=0) &&
-                                    (!(tilemap[grid[0]][grid[1]]&0x8000)) )
-                                break;
-                        }
-                        while (1);
-                        break;
-                    }
-                    else
-                        continue;
-                }
-                else
-                {
-                    mapseen[grid[0]][grid[1]]=1;
-                    break;
-                }
-            }
+        for (i=0; i<numrays; i++)
+        {
+            if (!active[i])
+                continue;
+
+            ray=&rays[i];
+            MarkRaySpot(ray,oldgrid[0][i],oldgrid[1][i]);
+            if (tilemap[grid[0][i]][grid[1][i]]==0)
+                continue;
+
+            ray->cnt=cnt[i];
+            ray->index=(index[i]!=0);
+            ray->grid[0]=grid[0][i];
+            ray->grid[1]=grid[1][i];
+            if (RayHitsTile(ray)==false)
+                WalkRay(ray);
+
+            active[i]=0;
+            numactive--;
+#ifdef __SSE2__
+            vactive=_mm_loadu_si128((__m128i *)active);
+#endif
         }
-        while (1);
-        HitWall(curx, cnt-incr[index], grid[0], grid[1]);
-        c_vx+=viewsin<<2;
-        c_vy+=viewcos<<2;
     }
 }
 
+//******************************************************************************
+//
+// CastRays ()
+//
+// Walks a set of rays and fills in their posts, spotvis is left alone
+//
+//******************************************************************************
 
-void Cast ( int curx )
+static void CastRays ( ray_t * rays, int numrays )
 {
-    int snx,sny;
-    int incr[2];
-    int thedir[2];
-    int cnt;
-    int grid[2];
-    int index;
-
-    c_vx=c_startx+(curx*viewsin);
-    c_vy=c_starty+(curx*viewcos);
-    snx=viewx&0xffff;
-    sny=viewy&0xffff;
+    ray_t * ray;
+    int i;
 
-    if (c_vx>0)
-    {
-        thedir[0]=1;
-        xtilestep=0x80;
-        snx^=0xffff;
-        incr[1]=-c_vx;
-    }
-    else
+    for (i=0; i<numrays; i+=CASTLANES)
+        WalkLanes(&rays[i],(numrays-i<CASTLANES) ? numrays-i : CASTLANES);
+
+    for (i=0; i<numrays; i++)
     {
-        thedir[0]=-1;
-        xtilestep=-0x80;
-        incr[1]=c_vx;
+        ray=&rays[i];
+        xtilestep=ray->xtilestep;
+        ytilestep=ray->ytilestep;
+        c_vx=ray->c_vx;
+        c_vy=ray->c_vy;
+        HitWall(ray->curx, ray->cnt-ray->incr[ray->index], ray->grid[0], ray->grid[1]);
     }
-    if (c_vy>0)
+}
+
+//******************************************************************************
+//
+// ApplyTrail ()
+//
+//******************************************************************************
+
+static void ApplyTrail ( ray_t * ray )
+{
+    int i;
+    int spot;
+
+    for (i=0; i<ray->traillength; i++)
     {
-        thedir[1]=1;
-        ytilestep=1;
-        sny^=0xffff;
-        incr[0]=c_vy;
+        spot=ray->trail[i];
+        if (spot&RAYWIDEDOOR)
+            MakeWideDoorVisible(spot&0x3ff);
+        else
+            SetSpotVisible(spot/MAPSIZE,spot%MAPSIZE);
     }
-    else
+}
+
+//******************************************************************************
+//
+// Refresh ()
+//
+// Casts every 4th column, then the columns in between only where the
+// neighbouring posts hit different tiles, interpolating the rest
+//
+//******************************************************************************
+
+void Refresh ( void )
+{
+    int group[CASTLANES];
+    int numsides[CASTLANES];
+    int numgroups;
+    int numside;
+    int x,i,j,s;
+
+// Cast Initial comb filter
+
+    for (x=0; x<=viewwidth; x+=4*CASTLANES)
     {
-        thedir[1]=-1;
-        ytilestep=-1;
-        incr[0]=-c_vy;
+        for (i=0; (i<CASTLANES) && (x+(i<<2)<=viewwidth); i++)
+            SetupRay(&combrays[i],x+(i<<2));
+        CastRays(combrays,i);
+        for (j=0; j<i; j++)
+            ApplyTrail(&combrays[j]);
     }
-    cnt=FixedMul(snx,incr[0])+FixedMul(sny,incr[1]);
-    grid[0]=viewx>>16;
-    grid[1]=viewy>>16;
-    do
+
+// Fill in the gaps, CASTLANES groups of four columns at a time
+
+    x=0;
+    while (x<=viewwidth-4)
     {
-        int tile;
+        numgroups=0;
+        for (; (x<=viewwidth-4) && (numgroups<CASTLANES); x+=4)
+        {
+            if NOTSAMETILE(x,x+4)
+            {
+                group[numgroups]=x;
+                SetupRay(&centerrays[numgroups],x+2);
+                numgroups++;
+            }
+            else
+                Interpolate(x,x+4);
+        }
+        if (numgroups==0)
+            continue;
 
-        index=(cnt>=0);
-        cnt+=incr[index];
-        spotvis[grid[0]][grid[1]]=1;
-        grid[index]+=thedir[index];
+        CastRays(centerrays,numgroups);
 
-        if ((tile=tilemap[grid[0]][grid[1]])!=0)
+        numside=0;
+        for (i=0; i<numgroups; i++)
         {
-            if (tile&0x8000)
+            numsides[i]=0;
+            if NOTSAMETILE(group[i],group[i]+2)
             {
-                if ( (!(tile&0x4000)) && (doorobjlist[tile&0x3ff]->action==dr_closed))
-                {
-                    spotvis[grid[0]][grid[1]]=1;
-                    if (doorobjlist[tile&0x3ff]->flags&DF_MULTI)
-                        MakeWideDoorVisible(tile&0x3ff);
-                    do
-                    {
-                        index=(cnt>=0);
-                        cnt+=incr[index];
-                        grid[index]+=thedir[index];
-                        if ((tilemap[grid[0]][grid[1]]!=0) &&
-                                (!(tilemap[grid[0]][grid[1]]&0x8000)) )
-                            break;
-                    }
-                    while (1);
-                    break;
-                }
-                else
-                    continue;
+                SetupRay(&siderays[numside++],group[i]+1);
+                numsides[i]++;
             }
             else
+                Interpolate (group[i],group[i]+2);
+            if NOTSAMETILE(group[i]+2,group[i]+4)
             {
-                mapseen[grid[0]][grid[1]]=1;
-                break;
+                SetupRay(&siderays[numside++],group[i]+3);
+                numsides[i]++;
             }
+            else
+                Interpolate (group[i]+2,group[i]+4);
+        }
+        CastRays(siderays,numside);
+
+        for (i=0,s=0; i<numgroups; i++)
+        {
+            ApplyTrail(&centerrays[i]);
+            for (j=0; j<numsides[i]; j++,s++)
+                ApplyTrail(&siderays[s]);
         }
     }
-    while (1);
-    HitWall(curx, cnt-incr[index], grid[0], grid[1]);
 }
-
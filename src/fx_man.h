@@ -99,10 +99,15 @@ int FX_PlayLoopedRaw( char *ptr, unsigned long length, char *loopstart,
                       char *loopend, unsigned rate, int pitchoffset, int vol, int left,
                       int right, int priority, unsigned long callbackval );
 int FX_Pan3D( int handle, int angle, int distance );
+int FX_SetOcclusion( int handle, int occluded );
 int FX_SoundActive( int handle );
 int FX_SoundsPlaying( void );
 int FX_StopSound( int handle );
 int FX_StopAllSounds( void );
+void FX_ServiceVoices( void );
+void FX_FlushVoiceUpdates( void );
+void FX_SetOutputFile( const char *name );
+void FX_GetMixStats( unsigned long *frames, unsigned long *usec );
 int FX_StartDemandFeedPlayback( void ( *function )( char **ptr, unsigned long *length ),
                                 int rate, int pitchoffset, int vol, int left, int right,
                                 int priority, unsigned long callbackval );
@@ -98,18 +98,36 @@ void ISR_SetTime(int settime)
     ticbase = settime;
 }
 
-/* developer-only */
+static Uint64 fastoffset; /* performance counter at last SetFastTics */
+static unsigned fastbase; /* game-supplied base */
 
-int GetFastTics (void)
+/*
+================
+=
+= GetFastTics
+=
+= High resolution timer, counts microseconds.  Wraps about every 71
+= minutes, so take differences in unsigned arithmetic
+=
+================
+*/
+
+unsigned GetFastTics (void)
 {
-    /* STUB_FUNCTION; */
+    Uint64 elapsed;
+    Uint64 freq;
+
+    elapsed = SDL_GetPerformanceCounter() - fastoffset;
+    freq = SDL_GetPerformanceFrequency();
 
-    return 0;
+    // Split the division so long runs cannot overflow the multiply
+    return (unsigned)((elapsed / freq) * 1000000 + ((elapsed % freq) * 1000000) / freq) + fastbase;
 }
 
-void SetFastTics (int settime)
+void SetFastTics (unsigned settime)
 {
-    /* STUB_FUNCTION; */
+    fastoffset = SDL_GetPerformanceCounter();
+    fastbase = settime;
 }
 
 /*
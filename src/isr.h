@@ -50,9 +50,9 @@ extern volatile int Keyboard[MAXKEYBOARDSCAN];   // Keyboard status array
 extern volatile int Keystate[MAXKEYBOARDSCAN];   // Keyboard state array
 
 int GetTicCount (void);
-int GetFastTics (void);
+unsigned GetFastTics (void);
 
-void SetFastTics(int);
+void SetFastTics(unsigned);
 
 extern int KeyboardStarted;
 
@@ -77,6 +77,8 @@ char        *bufofsTopLimit;
 char        *bufofsBottomLimit;
 
 void DrawCenterAim ();
+static void StartupPresent (void);
+static void ShutdownPresent (void);
 
 #ifndef STUB_FUNCTION
 
@@ -125,6 +127,8 @@ void GraphicsMode ( void )
                                     iGLOBAL_SCREENHEIGHT);
     
     sdl_surface = SDL_CreateRGBSurface(0,iGLOBAL_SCREENWIDTH,iGLOBAL_SCREENHEIGHT,8,0,0,0,0);
+
+    StartupPresent();
     
     
          
@@ -150,6 +154,8 @@ void SetTextMode ( void )
             sdl_surface = NULL;
         }
 
+        ShutdownPresent();
+
         SDL_QuitSubSystem (SDL_INIT_VIDEO);
     }
 }
@@ -270,48 +276,315 @@ void VL_ClearVideo (byte color)
     memset (sdl_surface->pixels, color, iGLOBAL_SCREENWIDTH*iGLOBAL_SCREENHEIGHT);
 }
 
+/*
+=================
+=
+= Presentation
+=
+= The 8 bit surface is converted into sdl_texture, which lives as long as
+= the renderer.  A full present converts and uploads the whole frame, a
+= dirty present only the blocks that changed since the last one.  Blocks
+= marked by VW_MarkUpdateBlock are taken as changed, the rest are compared
+= against a shadow copy so drawing that never marks the grid still shows.
+=
+=================
+*/
+
+#define PRESENTSHIFT    4
+#define PRESENTBLOCK    (1<<PRESENTSHIFT)
+#define PRESENTWIDE     ((MAXSCREENWIDTH+PRESENTBLOCK-1)>>PRESENTSHIFT)
+#define PRESENTHIGH     ((MAXSCREENHEIGHT+PRESENTBLOCK-1)>>PRESENTSHIFT)
+
+static byte      presentdirty[PRESENTWIDE*PRESENTHIGH];
+static byte     *shadowpixels = NULL;   // 8 bit copy of the texture contents
+static Uint32   *texpixels = NULL;      // ABGR conversion buffer
+static Uint32    texpalette[256];
+static SDL_Color shadowpalette[256];
+static boolean   palettevalid = false;
+static boolean   shadowvalid = false;
+
+static void StartupPresent (void)
+{
+    if (shadowpixels != NULL)
+        SafeFree (shadowpixels);
+    if (texpixels != NULL)
+        SafeFree (texpixels);
+
+    shadowpixels = SafeMalloc (iGLOBAL_SCREENWIDTH*iGLOBAL_SCREENHEIGHT);
+    texpixels = SafeMalloc (iGLOBAL_SCREENWIDTH*iGLOBAL_SCREENHEIGHT*sizeof(Uint32));
+    palettevalid = false;
+    shadowvalid = false;
+}
+
+static void ShutdownPresent (void)
+{
+    if (shadowpixels != NULL)
+    {
+        SafeFree (shadowpixels);
+        shadowpixels = NULL;
+    }
+    if (texpixels != NULL)
+    {
+        SafeFree (texpixels);
+        texpixels = NULL;
+    }
+}
+
+//
+// Returns true when the surface palette differs from the one the texture
+// was converted with
+//
+static boolean UpdatePresentPalette (void)
+{
+    SDL_Color *colors;
+    int i;
+
+    colors = sdl_surface->format->palette->colors;
+
+    if (palettevalid && !memcmp (shadowpalette, colors, sizeof(shadowpalette)))
+        return false;
+
+    memcpy (shadowpalette, colors, sizeof(shadowpalette));
+    for (i = 0; i < 256; i++)
+        texpalette[i] = 0xff000000 | ((Uint32)colors[i].b << 16) |
+                        ((Uint32)colors[i].g << 8) | (Uint32)colors[i].r;
+
+    palettevalid = true;
+    return true;
+}
+
+static void ConvertRect (int x, int y, int w, int h)
+{
+    byte   *src;
+    Uint32 *dest;
+    int     i, j;
+
+    for (j = y; j < y+h; j++)
+    {
+        src  = (byte *)sdl_surface->pixels + j*sdl_surface->pitch + x;
+        dest = texpixels + j*iGLOBAL_SCREENWIDTH + x;
+        for (i = 0; i < w; i++)
+            dest[i] = texpalette[src[i]];
+    }
+}
+
+static void UploadFull (void)
+{
+    UpdatePresentPalette ();
+    ConvertRect (0, 0, iGLOBAL_SCREENWIDTH, iGLOBAL_SCREENHEIGHT);
+    SDL_UpdateTexture (sdl_texture, NULL, texpixels, iGLOBAL_SCREENWIDTH*sizeof(Uint32));
+}
+
+//
+// Uploads the whole surface and brings the shadow copy up to date with it,
+// so the next dirty present compares against what the texture really shows
+//
+static void PresentFull (void)
+{
+    int y;
+
+    for (y = 0; y < iGLOBAL_SCREENHEIGHT; y++)
+        memcpy (shadowpixels + y*iGLOBAL_SCREENWIDTH,
+                (byte *)sdl_surface->pixels + y*sdl_surface->pitch,
+                iGLOBAL_SCREENWIDTH);
+    shadowvalid = true;
+    UploadFull ();
+}
+
+//
+// Copies one block into the shadow copy, returns true if it changed.
+// Marked blocks are copied without comparing.
+//
+static boolean UpdateShadowBlock (int x, int y, int w, int h, boolean marked)
+{
+    byte   *src;
+    byte   *dest;
+    boolean changed;
+    int     j;
+
+    changed = marked;
+    for (j = y; j < y+h; j++)
+    {
+        src  = (byte *)sdl_surface->pixels + j*sdl_surface->pitch + x;
+        dest = shadowpixels + j*iGLOBAL_SCREENWIDTH + x;
+        if (changed || memcmp (dest, src, w))
+        {
+            memcpy (dest, src, w);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+//
+// Maps the caller's update grid, in drawing coordinates, onto presentdirty
+//
+static void MarkPresentBlocks (byte *blocks, int wide, int high, int shift)
+{
+    int bx, by;
+    int x1, y1, x2, y2;
+    int x, y;
+    int pwide;
+
+    pwide = (iGLOBAL_SCREENWIDTH+PRESENTBLOCK-1)>>PRESENTSHIFT;
+
+    for (by = 0; by < high; by++)
+        for (bx = 0; bx < wide; bx++)
+        {
+            if (!blocks[by*wide+bx])
+                continue;
+
+            x1 = bx << shift;
+            y1 = by << shift;
+            x2 = x1 + (1 << shift) - 1;
+            y2 = y1 + (1 << shift) - 1;
+
+            if (StretchScreen)
+            {
+                // one pixel of slack for the stretch rounding
+                x1 = x1*iGLOBAL_SCREENWIDTH/320 - 1;
+                y1 = y1*iGLOBAL_SCREENHEIGHT/200 - 1;
+                x2 = (x2+1)*iGLOBAL_SCREENWIDTH/320 + 1;
+                y2 = (y2+1)*iGLOBAL_SCREENHEIGHT/200 + 1;
+            }
+
+            if (x1 < 0)
+                x1 = 0;
+            if (y1 < 0)
+                y1 = 0;
+            if (x2 >= iGLOBAL_SCREENWIDTH)
+                x2 = iGLOBAL_SCREENWIDTH-1;
+            if (y2 >= iGLOBAL_SCREENHEIGHT)
+                y2 = iGLOBAL_SCREENHEIGHT-1;
+
+            for (y = y1>>PRESENTSHIFT; y <= (y2>>PRESENTSHIFT); y++)
+                for (x = x1>>PRESENTSHIFT; x <= (x2>>PRESENTSHIFT); x++)
+                    presentdirty[y*pwide+x] = 1;
+        }
+}
+
+static void PresentDirty (void)
+{
+    int pwide, phigh;
+    int bx, by, run;
+    int x, y, w, h;
+    int count;
+    SDL_Rect rect;
+
+    pwide = (iGLOBAL_SCREENWIDTH+PRESENTBLOCK-1)>>PRESENTSHIFT;
+    phigh = (iGLOBAL_SCREENHEIGHT+PRESENTBLOCK-1)>>PRESENTSHIFT;
+
+    //
+    // A palette change touches every pixel, and without a shadow copy there
+    // is nothing to compare against
+    //
+    if (UpdatePresentPalette () || !shadowvalid)
+    {
+        PresentFull ();
+        memset (presentdirty, 0, pwide*phigh);
+        return;
+    }
+
+    count = 0;
+    for (by = 0; by < phigh; by++)
+    {
+        y = by << PRESENTSHIFT;
+        h = min (PRESENTBLOCK, iGLOBAL_SCREENHEIGHT-y);
+        for (bx = 0; bx < pwide; bx++)
+        {
+            x = bx << PRESENTSHIFT;
+            w = min (PRESENTBLOCK, iGLOBAL_SCREENWIDTH-x);
+            presentdirty[by*pwide+bx] =
+                UpdateShadowBlock (x, y, w, h, presentdirty[by*pwide+bx]);
+            count += presentdirty[by*pwide+bx];
+        }
+    }
+
+    if (count == 0)
+        return;
+
+    if (count*4 > pwide*phigh*3)
+    {
+        // the shadow copy is already current
+        UploadFull ();
+        memset (presentdirty, 0, pwide*phigh);
+        return;
+    }
+
+    //
+    // upload each horizontal run of dirty blocks as one rectangle
+    //
+    for (by = 0; by < phigh; by++)
+    {
+        y = by << PRESENTSHIFT;
+        h = min (PRESENTBLOCK, iGLOBAL_SCREENHEIGHT-y);
+        for (bx = 0; bx < pwide; bx = run)
+        {
+            if (!presentdirty[by*pwide+bx])
+            {
+                run = bx+1;
+                continue;
+            }
+            for (run = bx; (run < pwide) && presentdirty[by*pwide+run]; run++)
+                presentdirty[by*pwide+run] = 0;
+
+            x = bx << PRESENTSHIFT;
+            w = min (run << PRESENTSHIFT, iGLOBAL_SCREENWIDTH) - x;
+            ConvertRect (x, y, w, h);
+
+            rect.x = x;
+            rect.y = y;
+            rect.w = w;
+            rect.h = h;
+            SDL_UpdateTexture (sdl_texture, &rect, texpixels + y*iGLOBAL_SCREENWIDTH + x,
+                               iGLOBAL_SCREENWIDTH*sizeof(Uint32));
+        }
+    }
+}
+
+// kept between frames, both status bars are the same size
+static SDL_Texture *rescaletexture = NULL;
+static int rescalewidth;
+static int rescaleheight;
+
 void RescaleAreaOfTexture(SDL_Renderer* renderer, SDL_Texture * source, SDL_Rect src, SDL_Rect dest)
 {
-    SDL_Texture * sourceToResize = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, src.w, src.h);          
-    SDL_SetRenderTarget(renderer, sourceToResize);
+    if (rescaletexture == NULL || rescalewidth != src.w || rescaleheight != src.h)
+    {
+        if (rescaletexture != NULL)
+            SDL_DestroyTexture(rescaletexture);
+        rescaletexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, src.w, src.h);
+        rescalewidth = src.w;
+        rescaleheight = src.h;
+    }
+    SDL_SetRenderTarget(renderer, rescaletexture);
     SDL_RenderCopy(renderer, source, &src, NULL);
     // the folowing line should reset the target to default(the screen)
     SDL_SetRenderTarget(renderer, NULL);
     
-    SDL_RenderCopy(renderer, sourceToResize, NULL, &dest);
-    SDL_DestroyTexture(sourceToResize);
+    SDL_RenderCopy(renderer, rescaletexture, NULL, &dest);
 }
 
 int hudRescaleFactor = 1;
 
 void RenderSurface(void)
 {
-    SDL_Texture * newTex = SDL_CreateTextureFromSurface(renderer, sdl_surface);
-    
-    if (newTex == NULL) 
-    {
-        Error("CreateTextureFromSurface failed: %s\n", SDL_GetError());
-        exit(1);
-    }
-   
     SDL_RenderClear(renderer);
     
-    SDL_RenderCopy(renderer, newTex, NULL, NULL);
+    SDL_RenderCopy(renderer, sdl_texture, NULL, NULL);
     
     if (!StretchScreen && hudRescaleFactor > 1 && doRescaling)
     {
         if(SHOW_TOP_STATUS_BAR())
-            RescaleAreaOfTexture(renderer, newTex, (SDL_Rect) {(iGLOBAL_SCREENWIDTH - 320) >> 1, 0, 320, 16}, 
+            RescaleAreaOfTexture(renderer, sdl_texture, (SDL_Rect) {(iGLOBAL_SCREENWIDTH - 320) >> 1, 0, 320, 16}, 
                    (SDL_Rect) {(iGLOBAL_SCREENWIDTH - (320 * hudRescaleFactor)) >> 1, 0, 320*hudRescaleFactor, 16*hudRescaleFactor}); //Status Bar
         if(SHOW_BOTTOM_STATUS_BAR())
-            RescaleAreaOfTexture(renderer, newTex,(SDL_Rect) {(iGLOBAL_SCREENWIDTH - 320) >> 1, iGLOBAL_SCREENHEIGHT - 16, 320, 16},
+            RescaleAreaOfTexture(renderer, sdl_texture,(SDL_Rect) {(iGLOBAL_SCREENWIDTH - 320) >> 1, iGLOBAL_SCREENHEIGHT - 16, 320, 16},
                (SDL_Rect) {(iGLOBAL_SCREENWIDTH - (320* hudRescaleFactor)) >> 1, iGLOBAL_SCREENHEIGHT - 16*hudRescaleFactor, 320*hudRescaleFactor, 16*hudRescaleFactor}); //Bottom Bar
                    
     }
     
     SDL_RenderPresent(renderer);
-    
-    SDL_DestroyTexture(newTex);
 
 }
 
@@ -326,10 +599,35 @@ void VH_UpdateScreen (void)
         DrawCenterAim ();
     }
     
+    PresentFull();
     RenderSurface();
     
 }
 
+/*
+=================
+=
+= VH_UpdateDirtyScreen
+=
+= Presents only what changed, blocks is an update grid of wide*high
+= entries covering 1<<shift pixels each
+=
+=================
+*/
+
+void VH_UpdateDirtyScreen (byte *blocks, int wide, int high, int shift)
+{
+    if (StretchScreen) {
+        StretchMemPicture ();
+    } else {
+        DrawCenterAim ();
+    }
+
+    MarkPresentBlocks (blocks, wide, high, shift);
+    PresentDirty ();
+    RenderSurface ();
+}
+
 
 /*
 =================
@@ -346,6 +644,7 @@ void XFlipPage ( void )
     } else {
         DrawCenterAim ();
     }
+    PresentFull();
     RenderSurface();
     
 }
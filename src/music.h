@@ -78,6 +78,8 @@ int   MUSIC_PlaySong( char *song, int loopflag );
 
 // ROTT Special - SBF
 int   MUSIC_PlaySongROTT( char *song, int size, int loopflag);
+int   MUSIC_PlaySongCached( char *song, int size, int loopflag, const char *cachename );
+int   MUSIC_RenderSongCache( char *song, int size, const char *cachename );
 
 void  MUSIC_SetContext( int context );
 int   MUSIC_GetContext( void );
@@ -91,5 +93,7 @@ int   MUSIC_FadeActive( void );
 void  MUSIC_StopFade( void );
 void  MUSIC_RerouteMidiChannel( int channel, int cdecl ( *function )( int event, int c1, int c2 ) );
 void  MUSIC_RegisterTimbreBank( unsigned char *timbres );
+unsigned long MUSIC_GetUnderruns( unsigned long *bytes );
+int   MUSIC_GetSwitchTime( int *maxtime );
 
 #endif
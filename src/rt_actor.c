@@ -14065,7 +14065,7 @@ void StopWind
 {
     objtype *temp;
 
-    FX_SetReverb( 0 );
+    SD_SetReverb( 0 );
 
     SD_StopSound( WindHandle );
     WindDistance        = 1000;
@@ -283,7 +283,7 @@ void ResetPlaneptr ( void )
 
 void NextVisptr ( void )
 {
-    if (visptr < &vislist[MAXVISIBLE-1]) // don't let it overflo'
+    if (VisibleRoom()) // don't let it overflo'
         visptr++;
 }
 
@@ -295,7 +295,7 @@ void NextVisptr ( void )
 
 void ResetVisptr ( void )
 {
-    visptr = &vislist[0];
+    ResetVisibleList();
 }
 
 //******************************************************************************
@@ -1151,39 +1151,38 @@ void DrawTMenuBufVLine (int x, int y, int height, boolean up)
 
 void DrawMenuBufPropString (int px, int py, const char *string)
 {
-    byte  pix;
-    int   width,height,ht;
-    byte  *source, *dest, *origdest;
+    fontatlas_t *atlas;
+    const short *runs;
+    int   width,ht,num;
+    byte  *source, *dest;
     int   ch;
 
 
     if (MenuBufStarted==false)
         Error("Called DrawMenuBufPropString without menubuf started\n");
 
+    atlas = GetFontAtlas (CurrentFont);
     ht = CurrentFont->height;
-    dest = origdest = (byte*)menubuf+(px*TEXTUREHEIGHT)+py;
+    dest = (byte*)menubuf+(px*TEXTUREHEIGHT)+py;
 
     while ((ch = (unsigned char)*string++)!=0)
     {
-        ch -= 31;
+        ch = (ch - 31) & 0xff;
         width = CurrentFont->width[ch];
         source = ((byte *)CurrentFont)+CurrentFont->charofs[ch];
+        runs = GetAtlasGlyph (atlas, ch)->colruns;
         while (width--)
         {
-            height = ht;
-            while (height--)
+            num = *runs++;
+            while (num--)
             {
-                pix = *source;
-                if (pix)
-                    *dest = pix;
-
-                source++;
-                dest ++;
+                memcpy (dest + runs[0], source + runs[0], runs[1]);
+                runs += 2;
             }
 
+            source += ht;
             PrintX++;
-            origdest+=TEXTUREHEIGHT;
-            dest = origdest;
+            dest += TEXTUREHEIGHT;
         }
     }
 
@@ -1198,8 +1197,10 @@ void DrawMenuBufPropString (int px, int py, const char *string)
 
 void DrawMenuBufIString (int px, int py, const char *string, int color)
 {
-    byte  pix;
-    int   width,height,ht;
+    fontatlas_t *atlas;
+    const short *runs;
+    const byte  *map;
+    int   width,ht,num,i;
     byte  *source, *dest, *origdest;
     int   ch;
 
@@ -1211,6 +1212,8 @@ void DrawMenuBufIString (int px, int py, const char *string, int color)
         Error( "Intensity Color out of range\n" );
     }
 
+    atlas = GetIFontAtlas (IFont);
+    map = intensitytable + color;
     ht = IFont->height;
     dest = origdest = (byte*)menubuf+(px*TEXTUREHEIGHT)+py;
 
@@ -1232,27 +1235,23 @@ void DrawMenuBufIString (int px, int py, const char *string, int color)
             continue;
         }
 
-        ch -= 31;
+        ch = (ch - 31) & 0xff;
         width = IFont->width[ ch ];
 
         source = ( ( byte * )IFont ) + IFont->charofs[ ch ];
+        runs = GetAtlasGlyph (atlas, ch)->colruns;
 
         while (width--)
         {
-            height = ht;
-            while (height--)
+            num = *runs++;
+            while (num--)
             {
-                pix = *source;
-                if ( pix != 0xFE )
-                {
-                    *dest = ( ( byte )intensitytable[ ( pix << 8 ) + color ] );
-                    GetIntensityColor( pix );
-                }
-
-                source++;
-                dest ++;
+                for (i = runs[0]; i < runs[0] + runs[1]; i++)
+                    dest[i] = map[ source[i] << 8 ];
+                runs += 2;
             }
 
+            source += ht;
             PrintX++;
             origdest+=TEXTUREHEIGHT;
             dest = origdest;
@@ -1272,43 +1271,37 @@ void DrawMenuBufIString (int px, int py, const char *string, int color)
 
 void DrawTMenuBufPropString (int px, int py, const char *string)
 {
-    byte  pix;
-    int   width,height,ht;
-    byte  *source, *dest, *origdest;
+    fontatlas_t *atlas;
+    const short *runs;
+    int   width,num,i;
+    byte  *dest;
     int   ch;
 
 
     if (MenuBufStarted==false)
         Error("Called DrawTMenuBufPropString without menubuf started\n");
 
-    ht = CurrentFont->height;
-    dest = origdest = (byte*)menubuf+(px*TEXTUREHEIGHT)+py;
+    atlas = GetFontAtlas (CurrentFont);
+    dest = (byte*)menubuf+(px*TEXTUREHEIGHT)+py;
 
     shadingtable=colormap+(StringShade<<8);
     while ((ch = (unsigned char)*string++)!=0)
     {
-        ch -= 31;
+        ch = (ch - 31) & 0xff;
         width = CurrentFont->width[ch];
-        source = ((byte *)CurrentFont)+CurrentFont->charofs[ch];
+        runs = GetAtlasGlyph (atlas, ch)->colruns;
         while (width--)
         {
-            height = ht;
-            while (height--)
+            num = *runs++;
+            while (num--)
             {
-                pix = *source;
-                if (pix)
-                {
-                    pix = *dest;
-                    pix = *(shadingtable+pix);
-                    *dest = pix;
-                }
-                source++;
-                dest ++;
+                for (i = runs[0]; i < runs[0] + runs[1]; i++)
+                    dest[i] = *(shadingtable+dest[i]);
+                runs += 2;
             }
 
             PrintX++;
-            origdest+=TEXTUREHEIGHT;
-            dest = origdest;
+            dest += TEXTUREHEIGHT;
         }
     }
 }
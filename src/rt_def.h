@@ -228,10 +228,8 @@ long filelength(int handle);
 
 #define RUNSPEED                6000
 #define MINACTORDIST            0x9000l
-#define MAXSTATS                400                           // max number of lamps, bonus, etc
 
 #define MAXWALLTILES            105          // max number of wall tiles
-#define MAXACTORS               600
 #define NORTH                   0
 #define EAST                    1
 #define SOUTH                   2
@@ -75,8 +75,9 @@ byte             numactions[MAXTOUCHPLATES];
 int              totalactions;
 
 byte             TRIGGER[MAXTOUCHPLATES];
-doorobj_t	   *doorobjlist[MAXDOORS];
+doorobj_t	   **doorobjlist;
 int			   doornum;
+int			   maxdoors;
 maskedwallobj_t *maskobjlist[MAXMASKED];
 int            maskednum;
 
@@ -886,6 +887,7 @@ void ConnectAreas (void)
     int i;
 #define MASTER_DISK(ob) ((ob->obclass == diskobj) && (ob->flags & FL_MASTER))
 
+    SD_AreasChanged ();
     memset (areabyplayer,0,sizeof(areabyplayer));
     for (i=0; i<numplayers; i++)
     {
@@ -950,6 +952,9 @@ void InitAreas (void)
 void InitDoorList (void)
 {
     doornum=0;
+    doorobjlist=NULL;
+    maxdoors=0;
+    ReserveDoors (MAXDOORS);
     pwallnum=0;
     maskednum=0;
     lasttouch = 0;
@@ -1045,6 +1050,38 @@ int IsDoor (int tilex, int tiley)
 }
 
 
+/*
+===============
+=
+= ReserveDoors
+=
+= Makes room in doorobjlist for count doors.  The list lives in level
+= memory, so it goes away with the level like the doors themselves.
+=
+===============
+*/
+
+void ReserveDoors (int count)
+{
+    doorobj_t ** newlist;
+
+    if (count <= maxdoors)
+        return;
+    if (count > MAXDOORINDEX)
+        Error ("Too many doors on level!");
+
+    newlist = (doorobj_t **)Z_LevelMalloc(count*sizeof(doorobj_t *),PU_LEVELSTRUCT,NULL);
+    if (!newlist)
+        Error("ReserveDoors: Failed on allocation of %d doors ",count);
+    if (doorobjlist)
+    {
+        memcpy(newlist,doorobjlist,doornum*sizeof(doorobj_t *));
+        Z_Free(doorobjlist);
+    }
+    doorobjlist=newlist;
+    maxdoors=count;
+}
+
 /*
 ===============
 =
@@ -1060,6 +1097,13 @@ void SpawnDoor (int tilex, int tiley, int lock, int texture)
     int up,dn,lt,rt;
     int basetexture;
 
+    if (doornum==maxdoors)
+    {
+        if (doornum==MAXDOORINDEX)
+            Error ("Too many doors on level!");
+        ReserveDoors (min(maxdoors<<1,MAXDOORINDEX));
+    }
+
     doorobjlist[doornum]=(doorobj_t*)Z_LevelMalloc(sizeof(doorobj_t),PU_LEVELSTRUCT,NULL);
     if (!doorobjlist[doornum])
         Error("SpawnDoor: Failed on allocation of door %d ",doornum);
@@ -1273,8 +1317,6 @@ void SpawnDoor (int tilex, int tiley, int lock, int texture)
         PreCacheLump(lastdoorobj->texture+i,PU_CACHEWALLS,cache_patch_t);
     doornum++;
     lastdoorobj++;
-    if (doornum==MAXDOORS)
-        Error ("Too many doors on level!");
 
 }
 
@@ -1300,7 +1342,7 @@ void MakeWideDoorVisible ( int doornum )
         dy=1;
     else
         dx=1;
-    spotvis[dr->tilex][dr->tiley]=1;
+    SetSpotVisible(dr->tilex,dr->tiley);
     tx=dr->tilex+dx;
     ty=dr->tiley+dy;
     while (M_ISDOOR(tx,ty))
@@ -1311,7 +1353,7 @@ void MakeWideDoorVisible ( int doornum )
         dr2=doorobjlist[num];
         if (!(dr2->flags&DF_MULTI))
             break;
-        spotvis[tx][ty]=1;
+        SetSpotVisible(tx,ty);
 
         tx+=dx;
         ty+=dy;
@@ -1326,7 +1368,7 @@ void MakeWideDoorVisible ( int doornum )
         dr2=doorobjlist[num];
         if (!(dr2->flags&DF_MULTI))
             break;
-        spotvis[tx][ty]=1;
+        SetSpotVisible(tx,ty);
 
         tx-=dx;
         ty-=dy;
@@ -26,7 +26,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define MAXTOUCHPLATES 64
 #define MAXMASKED      300  // max masked walls
-#define MAXDOORS       150  // max number of sliding doors
+#define MAXDOORS       150  // initial size of the door list, grown as needed
+#define MAXDOORINDEX   0x400 // door numbers are kept in 10 bits of tilemap
 #define MAXPWALLS      150  // max number of pushwalls
 #define DF_TIMED       0x01
 #define DF_ELEVLOCKED  0x02
@@ -187,8 +188,9 @@ extern byte                touchindices[MAPSIZE][MAPSIZE],lasttouch;
 extern touchplatetype      *touchplate[MAXTOUCHPLATES],*lastaction[MAXTOUCHPLATES];
 extern byte                TRIGGER[MAXTOUCHPLATES];
 
-extern doorobj_t           *doorobjlist[MAXDOORS];
+extern doorobj_t           **doorobjlist;
 extern int                 doornum;
+extern int                 maxdoors;
 extern maskedwallobj_t     *maskobjlist[MAXMASKED];
 extern int                 maskednum;
 extern pwallobj_t          *pwallobjlist[MAXPWALLS];
@@ -199,6 +201,7 @@ extern boolean             areabyplayer[NUMAREAS];
 
 
 void ActivateAllPushWalls(void);
+void ReserveDoors (int count);
 boolean CheckTile(int,int);
 void FindEmptyTile(int*,int*);
 int  Number_of_Empty_Tiles_In_Area_Around(int,int);
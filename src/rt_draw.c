@@ -55,6 +55,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "rt_rand.h"
 #include "rt_net.h"
 #include "rt_sc_a.h"
+#include "rt_prof.h"
+#include "rt_jobs.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 extern void VH_UpdateScreen (void);
@@ -70,16 +75,21 @@ Global Variables
 =============================================================================
 */
 
-int iG_masked;
-
 int whereami=-1;
 
 byte * shadingtable;
 
 word   tilemap[MAPSIZE][MAPSIZE]; // wall values only
 byte   spotvis[MAPSIZE][MAPSIZE];
+word   visiblespots[MAPSIZE*MAPSIZE];
+int    numvisiblespots;
+static byte spotnear[MAPSIZE][MAPSIZE];     // spotvis grown by one tile
+static word nearspots[MAPSIZE*MAPSIZE];
+static int  numnearspots;
 byte   mapseen[MAPSIZE][MAPSIZE];
 unsigned long * lights;
+byte          * tilelights;
+static int      walllightadd[4];    // shade added per posttype this frame
 
 int         wstart;
 
@@ -128,7 +138,8 @@ int levelheight;
 int actortime=0;
 int drawtime=0;
 
-visobj_t vislist[MAXVISIBLE],*visptr,*visstep,*farthest;
+visobj_t *vislist=NULL,*visptr,*visstep,*farthest;
+int maxvisible=0;
 
 int firstcoloffset=0;
 
@@ -141,7 +152,9 @@ int firstcoloffset=0;
 */
 static int nonbobpheight;
 
-static visobj_t * sortedvislist[MAXVISIBLE];
+static visobj_t ** sortedvislist;
+static visobj_t ** radixtemp;
+static boolean visoverflow=false;
 
 static const fixed mindist = 0x1000;
 
@@ -292,6 +305,8 @@ void BuildTables (void)
     // Check out VENDOR.DOC file
     CheckVendor();
 
+    SetVisibleListSize(MAXVISIBLE);
+
     if (!quiet)
         printf("RT_DRAW: Tables Initialized\n");
 }
@@ -732,34 +747,156 @@ int   CalcRotate (objtype *ob)
 
 }
 
+/*
+======================
+=
+= SetVisibleListSize
+=
+= Grows vislist and its sort buffers to hold size objects.  The list is
+= never shrunk, so after the first few levels drawing does not allocate.
+=
+======================
+*/
+
+void SetVisibleListSize (int size)
+{
+    if (size <= maxvisible)
+        return;
+
+    if (vislist!=NULL)
+    {
+        SafeFree(vislist);
+        SafeFree(sortedvislist);
+        SafeFree(radixtemp);
+    }
+    vislist = (visobj_t *)SafeMalloc(size*sizeof(visobj_t));
+    sortedvislist = (visobj_t **)SafeMalloc(size*sizeof(visobj_t *));
+    radixtemp = (visobj_t **)SafeMalloc(size*sizeof(visobj_t *));
+    maxvisible = size;
+    visptr = &vislist[0];
+}
+
+/*
+======================
+=
+= ResetVisibleList
+=
+= Starts a new vislist.  If the last one ran out of room it is doubled
+= first; objects that did not fit were only missing for that frame.
+=
+======================
+*/
+
+void ResetVisibleList (void)
+{
+    if (visoverflow==true)
+    {
+        SetVisibleListSize(maxvisible<<1);
+        visoverflow=false;
+    }
+    visptr = &vislist[0];
+}
+
+/*
+======================
+=
+= VisibleRoom
+=
+= Returns true if visptr can advance to another entry
+=
+======================
+*/
+
+boolean VisibleRoom (void)
+{
+    if (visptr < &vislist[maxvisible-1])
+        return true;
+    visoverflow=true;
+    return false;
+}
+
 /*
 ======================
 =
 = SortScaleds
-= Sort the scaleds using a HEAPSORT
+= Sort the scaleds back to front by viewheight.  Small lists use an
+= insertion sort, larger ones an LSD radix sort on the height bytes.
+= Both are stable, so equal heights keep their vislist order.
 =
 ======================
 */
 
 #define SGN(x)          ((x>0) ? (1) : ((x==0) ? (0) : (-1)))
 
+#define RADIXTHRESHOLD  32
+
 /*--------------------------------------------------------------------------*/
-int CompareHeights(s1p,s2p) visobj_t **s1p,**s2p;
+static void InsertionSortVisibleList( int numvisible )
 {
-    whereami=3;
-    return SGN((*s1p)->viewheight-(*s2p)->viewheight);
+    int i,j;
+    visobj_t * temp;
+
+    for (i=1; i<numvisible; i++)
+    {
+        temp=sortedvislist[i];
+        for (j=i; (j>0) && (sortedvislist[j-1]->viewheight > temp->viewheight); j--)
+            sortedvislist[j]=sortedvislist[j-1];
+        sortedvislist[j]=temp;
+    }
 }
 
-void SwitchPointers(s1p,s2p) visobj_t **s1p,**s2p;
+/*--------------------------------------------------------------------------*/
+static void RadixSortVisibleList( int numvisible )
 {
-    visobj_t * temp;
+    int counts[4][256];
+    unsigned key;
+    visobj_t ** src;
+    visobj_t ** dest;
+    visobj_t ** swap;
+    int pass,i,sum,c;
 
-    whereami=4;
-    temp=*s1p;
-    *s1p=*s2p;
-    *s2p=temp;
-}
+    memset(counts,0,sizeof(counts));
 
+    // Flip the sign bit so negative heights order below positive ones
+
+    for (i=0; i<numvisible; i++)
+    {
+        key=(unsigned)sortedvislist[i]->viewheight ^ 0x80000000;
+        counts[0][key&0xff]++;
+        counts[1][(key>>8)&0xff]++;
+        counts[2][(key>>16)&0xff]++;
+        counts[3][key>>24]++;
+    }
+
+    src=&sortedvislist[0];
+    dest=&radixtemp[0];
+    for (pass=0; pass<4; pass++)
+    {
+        // A byte that is the same for every entry leaves the order alone
+
+        key=((unsigned)src[0]->viewheight ^ 0x80000000) >> (pass<<3);
+        if (counts[pass][key&0xff]==numvisible)
+            continue;
+
+        for (sum=0,i=0; i<256; i++)
+        {
+            c=counts[pass][i];
+            counts[pass][i]=sum;
+            sum+=c;
+        }
+        for (i=0; i<numvisible; i++)
+        {
+            key=((unsigned)src[i]->viewheight ^ 0x80000000) >> (pass<<3);
+            dest[counts[pass][key&0xff]++]=src[i];
+        }
+        swap=src;
+        src=dest;
+        dest=swap;
+    }
+
+    if (src!=&sortedvislist[0])
+        memcpy(sortedvislist,src,numvisible*sizeof(visobj_t *));
+}
 
 void SortVisibleList( int numvisible, visobj_t * vlist )
 {
@@ -768,7 +905,74 @@ void SortVisibleList( int numvisible, visobj_t * vlist )
     whereami=5;
     for (i=0; i<numvisible; i++)
         sortedvislist[i]=&(vlist[i]);
-    hsort((char *)&(sortedvislist[0]),numvisible,sizeof(visobj_t *),&CompareHeights,&SwitchPointers);
+    if (numvisible<RADIXTHRESHOLD)
+        InsertionSortVisibleList(numvisible);
+    else
+        RadixSortVisibleList(numvisible);
+}
+
+/*
+=====================
+=
+= ClearVisibleSpots
+=
+= Clears only the spotvis tiles marked last frame
+=
+=====================
+*/
+
+void ClearVisibleSpots (void)
+{
+    int i;
+
+    for (i=0; i<numvisiblespots; i++)
+        ((byte *)spotvis)[visiblespots[i]]=0;
+    numvisiblespots=0;
+}
+
+/*
+=====================
+=
+= MarkNearSpots
+=
+= An object may overhang into a visible tile from any of the eight
+= around its own, so grow the visible tiles by one into spotnear, which
+= then answers that with a single lookup
+=
+=====================
+*/
+
+void MarkNearSpots (void)
+{
+    int i;
+    int x,y;
+    int tx,ty;
+    int spot;
+
+    for (i=0; i<numnearspots; i++)
+        ((byte *)spotnear)[nearspots[i]]=0;
+    numnearspots=0;
+
+    for (i=0; i<numvisiblespots; i++)
+    {
+        x=visiblespots[i]/MAPSIZE;
+        y=visiblespots[i]%MAPSIZE;
+        for (tx=x-1; tx<=x+1; tx++)
+        {
+            if ((tx<0) || (tx>=MAPSIZE))
+                continue;
+            for (ty=y-1; ty<=y+1; ty++)
+            {
+                if ((ty<0) || (ty>=MAPSIZE))
+                    continue;
+                if (spotnear[tx][ty])
+                    continue;
+                spot=(tx*MAPSIZE)+ty;
+                spotnear[tx][ty]=1;
+                nearspots[numnearspots++]=spot;
+            }
+        }
+    }
 }
 
 /*
@@ -790,7 +994,7 @@ void DrawScaleds (void)
 
     int   i,numvisible;
     int   gx,gy;
-    byte   *visspot;
+    int   tile;
     boolean result;
     statobj_t *statptr;
     objtype   *obj;
@@ -798,12 +1002,18 @@ void DrawScaleds (void)
 
     whereami=6;
 
+    MarkNearSpots();
+
 //
-// place maskwall objects
+// place maskwall objects, found through the tiles the rays crossed
 //
-    for(tmwall=FIRSTMASKEDWALL; tmwall; tmwall=tmwall->next)
+    for (i=0; i<numvisiblespots; i++)
     {
-        if (spotvis[tmwall->tilex][tmwall->tiley])
+        tile=((word *)tilemap)[visiblespots[i]];
+        if ((tile&0xc000)!=0xc000)
+            continue;
+        tmwall=maskobjlist[tile&0x3ff];
+        if (tmwall->flags&MW_ABP)          // only those in FIRSTMASKEDWALL
         {
             mapseen[tmwall->tilex][tmwall->tiley]=1;
             if (tmwall->vertical)
@@ -848,7 +1058,7 @@ void DrawScaleds (void)
             {
                 visptr->shapenum++;
             }
-            if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+            if (VisibleRoom() && (result==true)) // don't let it overflo'
                 visptr++;
         }
     }
@@ -866,16 +1076,7 @@ void DrawScaleds (void)
                 (visptr->shapenum >= shapestop))
             Error("actor shapenum %d out of range (%d-%d)",visptr->shapenum,shapestart,shapestop);
 
-        visspot = statptr->visspot;
-        if (!((*(visspot-0)) ||
-                (*(visspot-1)) ||
-                (*(visspot+1)) ||
-                (*(visspot-129)) ||
-                (*(visspot-128)) ||
-                (*(visspot-127)) ||
-                (*(visspot+129)) ||
-                (*(visspot+128)) ||
-                (*(visspot+127))))
+        if (!spotnear[statptr->tilex][statptr->tiley])
         {   statptr->flags &= ~FL_VISIBLE;
             continue;     // not visible
         }
@@ -951,7 +1152,7 @@ void DrawScaleds (void)
             }
         }
 
-        if (visptr < &vislist[MAXVISIBLE-1]) // don't let it overflo'
+        if (VisibleRoom()) // don't let it overflo'
             visptr++;
 
 
@@ -972,20 +1173,11 @@ void DrawScaleds (void)
         if ((visptr->shapenum <= shapestart) ||
                 (visptr->shapenum >= shapestop))
             Error("actor shapenum %d out of range (%d-%d)",visptr->shapenum,shapestart,shapestop);
-        visspot = &spotvis[obj->tilex][obj->tiley];
 
         //
         // could be in any of the nine surrounding tiles
         //
-        if (*visspot
-                || ( *(visspot-1))
-                || ( *(visspot+1))
-                || ( *(visspot-129))
-                || ( *(visspot-128))
-                || ( *(visspot-127))
-                || ( *(visspot+129))
-                || ( *(visspot+128))
-                || ( *(visspot+127)) )
+        if (spotnear[obj->tilex][obj->tiley])
         {
 
 //        result = TransformObject (obj->drawx, obj->drawy,&(visptr->viewx),&(visptr->viewheight));
@@ -1065,7 +1257,7 @@ void DrawScaleds (void)
                 visptr->shapenum++;
             }
 
-            if (visptr < &vislist[MAXVISIBLE-1]) // don't let it overflo'
+            if (VisibleRoom()) // don't let it overflo'
                 visptr++;
             obj->flags |= FL_SEEN;
             obj->flags |= FL_VISIBLE;
@@ -1431,7 +1623,7 @@ void SetSpriteLightLevel (int x, int y, visobj_t * sprite, int dir, int fullbrig
 
     if (fog)
     {
-        i=((sprite->viewheight*200/iGLOBAL_SCREENHEIGHT)>>normalshade)+minshade;
+        i=((sprite->viewheight*200/renderheight)>>normalshade)+minshade;
         if (i>maxshade) i=maxshade;
         sprite->colormap=colormap+(i<<8);
     }
@@ -1444,7 +1636,7 @@ void SetSpriteLightLevel (int x, int y, visobj_t * sprite, int dir, int fullbrig
             else
                 intercept=(y>>11)&0x1c;
 
-            lv=(((LightSourceAt(x>>16,y>>16)>>intercept)&0xf)>>1);
+            lv=LightLevelAt(x>>16,y>>16,intercept);
             i=maxshade-(sprite->viewheight>>normalshade)-lv;
             if (i<minshade) i=minshade;
             sprite->colormap=colormap+(i<<8);
@@ -1492,7 +1684,7 @@ void SetColorLightLevel (int x, int y, visobj_t * sprite, int dir, int color, in
 
     if (fog)
     {
-        i=((height*200/iGLOBAL_SCREENHEIGHT)>>normalshade)+minshade;
+        i=((height*200/renderheight)>>normalshade)+minshade;
         if (i>maxshade) i=maxshade;
         sprite->colormap=map+(i<<8);
     }
@@ -1505,7 +1697,7 @@ void SetColorLightLevel (int x, int y, visobj_t * sprite, int dir, int color, in
             else
                 intercept=(y>>11)&0x1c;
 
-            lv=(((LightSourceAt(x>>16,y>>16)>>intercept)&0xf)>>1);
+            lv=LightLevelAt(x>>16,y>>16,intercept);
             i=maxshade-(height>>normalshade)-lv;
             if (i<minshade) i=minshade;
             sprite->colormap=map+(i<<8);
@@ -1519,6 +1711,46 @@ void SetColorLightLevel (int x, int y, visobj_t * sprite, int dir, int color, in
     }
 }
 
+/*
+==========================
+=
+= CacheTileLight
+=
+= Unpacks the light source nibbles of one tile, called whenever they change
+=
+==========================
+*/
+
+void CacheTileLight (int x, int y)
+{
+    unsigned long level;
+    byte * cache;
+    int i;
+
+    level=LightSourceAt(x,y);
+    cache=tilelights+((((x)<<7)+(y))<<3);
+    for (i=0; i<8; i++,level>>=4)
+        cache[i]=(level&0xf)>>1;
+}
+
+/*
+==========================
+=
+= SetupWallLights
+=
+= Resolves the per posttype shade for the frame
+=
+==========================
+*/
+
+void SetupWallLights (void)
+{
+    walllightadd[0]=0;
+    walllightadd[1]=4;
+    walllightadd[2]=(4-gamestate.difficulty);
+    walllightadd[3]=3+(4-gamestate.difficulty);
+}
+
 /*
 ==========================
 =
@@ -1540,32 +1772,10 @@ void SetWallLightLevel (wallcast_t * post)
         return;
     }
 
-    switch (post->posttype)
-    {
-    case 0:
-        la=0;
-        break;
-    case 1:
-        la=4;
-        break;
-    case 2:
-        la=(4-gamestate.difficulty);
-        break;
-    case 3:
-        la=3+(4-gamestate.difficulty);
-        break;
-    }
+    la=walllightadd[post->posttype&3];
 
     if (lightsource)
-    {
-        int x,y;
-        int intercept;
-
-        x=post->offset>>7;
-        y=post->offset&0x7f;
-        intercept=(post->texture>>11)&0x1c;
-        lv=(((LightSourceAt(x,y)>>intercept)&0xf)>>1);
-    }
+        lv=LightLevelAt(post->offset>>7,post->offset&0x7f,(post->texture>>11)&0x1c);
     else
         lv=0;
     if (fulllight)
@@ -1587,7 +1797,7 @@ void SetWallLightLevel (wallcast_t * post)
     }
     if (fog)
     {
-        i =((post->wallheight*200/iGLOBAL_SCREENHEIGHT)>>normalshade)+minshade-lv+la;
+        i =((post->wallheight*200/renderheight)>>normalshade)+minshade-lv+la;
         if (i>maxshade+la) i=maxshade+la;
         shadingtable=colormap+(i<<8);
     }
@@ -1824,7 +2034,7 @@ void TransformDoors( void )
                 {
                     doorptr->shapesize=3;
                     memcpy(visptr,doorptr,sizeof(visobj_t));
-                    if (visptr < &vislist[MAXVISIBLE-1])
+                    if (VisibleRoom())
                         visptr++;
                 }
             }
@@ -1895,7 +2105,7 @@ void TransformPushWalls( void )
                     visptr->shapenum=pwallobjlist[i]->texture;
                     visptr->shapesize=((pwallobjlist[i]->x>>16)<<7)+(pwallobjlist[i]->y>>16);
                     visptr->viewx+=2;
-                    if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+                    if (VisibleRoom() && (result==true)) // don't let it overflo'
                         visptr++;
                     visptr->texturestart=(gy-0x8000)&0xffff;
                     visptr->textureend=visptr->texturestart;//-0xffff;
@@ -1909,7 +2119,7 @@ void TransformPushWalls( void )
                     visptr->shapenum=pwallobjlist[i]->texture;
                     visptr->shapesize=((pwallobjlist[i]->x>>16)<<7)+(pwallobjlist[i]->y>>16);
                     visptr->viewx+=2;
-                    if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+                    if (VisibleRoom() && (result==true)) // don't let it overflo'
                         visptr++;
                     visptr->texturestart=(gx-0x8000)&0xffff;
                     visptr->textureend=visptr->texturestart;//-0xffff;
@@ -1928,7 +2138,7 @@ void TransformPushWalls( void )
                     visptr->shapenum=pwallobjlist[i]->texture;
                     visptr->shapesize=((pwallobjlist[i]->x>>16)<<7)+(pwallobjlist[i]->y>>16);
                     visptr->viewx+=2;
-                    if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+                    if (VisibleRoom() && (result==true)) // don't let it overflo'
                         visptr++;
                     visptr->texturestart=(gx-0x8000)&0xffff;
                     visptr->textureend=visptr->texturestart;
@@ -1944,7 +2154,7 @@ void TransformPushWalls( void )
                     visptr->shapenum=pwallobjlist[i]->texture;
                     visptr->shapesize=((pwallobjlist[i]->x>>16)<<7)+(pwallobjlist[i]->y>>16);
                     visptr->viewx+=2;
-                    if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+                    if (VisibleRoom() && (result==true)) // don't let it overflo'
                         visptr++;
                     visptr->texturestart=(gy-0x8000)&0xffff;
                     visptr->textureend=visptr->texturestart;
@@ -1956,7 +2166,7 @@ void TransformPushWalls( void )
             visptr->viewx+=2;
             visptr->shapenum=pwallobjlist[i]->texture;
             visptr->shapesize=((pwallobjlist[i]->x>>16)<<7)+(pwallobjlist[i]->y>>16);
-            if ((visptr < &vislist[MAXVISIBLE-1]) && (result==true)) // don't let it overflo'
+            if (VisibleRoom() && (result==true)) // don't let it overflo'
                 visptr++;
         }
     }
@@ -1992,7 +2202,7 @@ void TransformPushWalls( void )
 
 void WallRefresh (void)
 {
-    volatile int dtime;
+    volatile unsigned dtime;
     int mag;
     int yzangle;
 
@@ -2007,7 +2217,7 @@ void WallRefresh (void)
         viewy=missobj->y+sintable[viewangle];
         pheight = missobj->z + 32;
         nonbobpheight=pheight;
-        spotvis[missobj->tilex][missobj->tiley]=1;
+        SetSpotVisible(missobj->tilex,missobj->tiley);
         yzangle=missobj->yzangle;
     }
     else
@@ -2051,7 +2261,7 @@ void WallRefresh (void)
             weaponboby=0;
         }
         yzangle=player->yzangle;
-        spotvis[player->tilex][player->tiley]=1;
+        SetSpotVisible(player->tilex,player->tiley);
     }
 
     if (yzangle > ANG180)
@@ -2098,9 +2308,10 @@ void WallRefresh (void)
     TransformPushWalls();
     TransformDoors();
     UpdateClientControls();
+    SetupWallLights();
     DrawWalls();
     UpdateClientControls();
-    walltime=GetFastTics()-dtime;
+    walltime=(int)(GetFastTics()-dtime);
 
 }
 
@@ -2460,9 +2671,12 @@ int playerview=0;
 void      ThreeDRefresh (void)
 {
     objtype * tempptr;
+    boolean dynamicview;
+    unsigned refreshtime;
 
     whereami=21;
     tempptr=player;
+    refreshtime=GetFastTics();
 
 //
 // Erase old messages
@@ -2472,6 +2686,8 @@ void      ThreeDRefresh (void)
 
     bufferofs += screenofs;
 
+    dynamicview = BeginDynamicView();
+
     RefreshClear();
 
     UpdateClientControls ();
@@ -2480,7 +2696,7 @@ void      ThreeDRefresh (void)
 // follow the walls from there to the right, drawwing as we go
 //
 
-    visptr = &vislist[0];
+    ResetVisibleList ();
     WallRefresh ();
 
     UpdateClientControls ();
@@ -2517,8 +2733,13 @@ void      ThreeDRefresh (void)
 
         if (player->flags&FL_GASMASK)
             DrawScreenSizedSprite(gmasklump);
+    }
 
+    if (dynamicview)
+        EndDynamicView();
 
+    if (!missobj)
+    {
         if ( SHOW_PLAYER_STATS() )
         {
             DrawStats ();
@@ -2563,7 +2784,12 @@ void      ThreeDRefresh (void)
     UpdateClientControls ();
 
     if (HUD == true)
+    {
         DrawPlayerLocation();
+        PROF_Draw();
+    }
+
+    UpdateDynamicResolution((int)(GetFastTics()-refreshtime));
 
     FlipPage();
     gamestate.frame++;
@@ -2731,153 +2957,46 @@ void DoLoadGameSequence ( void )
 //
 // StartupRotateBuffer
 //
+// Takes a copy of the screen for DrawRotatedScreen.  Rows are kept a power
+// of two apart so the blitter can find a texel with a shift.
+//
 //******************************************************************************
 byte * RotatedImage;
 boolean RotateBufferStarted = false;
+static int rotwidth;
+static int rotheight;
+static int rotshift;
+
 void StartupRotateBuffer ( int masked)
 {
-    int k;////zxcv
-    int a,b;
-
-//   int Xres = 320;//org
-//   int Yres = 200;//org
-
-    iG_masked = masked;
+    int y;
 
     if (RotateBufferStarted == true)
         return;
 
     RotateBufferStarted = true;
 
-    //   RotatedImage=SafeMalloc(131072);org
-    //RotatedImage=SafeMalloc(131072*8);
-    
-    
-    //int amountToAlloc = ((iGLOBAL_SCREENWIDTH * iGLOBAL_SCREENHEIGHT)*2) + 3072; //this replaces 131072
-    
-    RotatedImage = SafeMalloc(131072);
-    
-/*
-    if (iGLOBAL_SCREENWIDTH == 320) {
-        RotatedImage=SafeMalloc(131072);
-    } else if (iGLOBAL_SCREENWIDTH == 640) {
-        RotatedImage=SafeMalloc(131072*4);
-    } else if (iGLOBAL_SCREENWIDTH == 800) {
-        RotatedImage=SafeMalloc(131072*8);
-    }
-    else if (iGLOBAL_SCREENWIDTH == 1024)
-    {
-        RotatedImage=SafeMalloc(131072*14);
-    }
-    else if (iGLOBAL_SCREENWIDTH == 1280)
-    {
-        RotatedImage=SafeMalloc(131072*20);
-    }
-    else if (iGLOBAL_SCREENWIDTH == 1400)
-    {
-        RotatedImage=SafeMalloc(131072*20);
-    }
-    else if (iGLOBAL_SCREENWIDTH == 1920)
+    // The masked Apogee logo is drawn in the 320x200 corner, everything
+    // else turns the whole screen
+    if (masked == true)
     {
-        RotatedImage=SafeMalloc(131072*50);
+        rotwidth = 320;
+        rotheight = 200;
     }
-*/
-//SetupScreen(false);//used these 2 to test screen size
-//VW_UpdateScreen ();
-    if (masked==0) 
-        memset(RotatedImage, 0, 131072);
     else
-        memset(RotatedImage, 0xff, 131072);
-/*
-        if (iGLOBAL_SCREENWIDTH == 320) {
-            memset(RotatedImage,0,131072);
-        } else if (iGLOBAL_SCREENWIDTH == 640) {
-            memset(RotatedImage,0,131072*4);
-        } else if (iGLOBAL_SCREENWIDTH == 800) {
-            //memset(RotatedImage,0,131072);//org
-            memset(RotatedImage,0,131072*8);
-        }else if (iGLOBAL_SCREENWIDTH == 1024) { 
-            memset(RotatedImage,0,131072*14);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1280)
-        {
-            memset(RotatedImage, 0, 131072*20);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1400)
-        {
-            memset(RotatedImage, 0, 131072*20);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1920)
-        {
-            memset(RotatedImage, 0, 131072*50);
-        }
-    } else {
-        if (iGLOBAL_SCREENWIDTH == 320) {
-            memset(RotatedImage,0xff,131072);
-        } else if (iGLOBAL_SCREENWIDTH == 640) {
-            memset(RotatedImage,0xff,131072*4);
-        } else if (iGLOBAL_SCREENWIDTH == 800) {
-            memset(RotatedImage,0xff,131072*8);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1024) { 
-            memset(RotatedImage,0xff,131072*14);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1280)
-        {
-            memset(RotatedImage, 0xff, 131072*20);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1400)
-        {
-            memset(RotatedImage, 0xff, 131072*20);
-        }
-        else if (iGLOBAL_SCREENWIDTH == 1920)
-        {
-            memset(RotatedImage, 0xff, 131072*50);
-        }
-*/
-    
-    //memset(RotatedImage,0xff,131072);//org
-    //memset(RotatedImage,0xff,131072*8);
-
-    if ((masked == false)&&(iGLOBAL_SCREENWIDTH >= 800)) {
-        DisableScreenStretch();
-        // SetTextMode (  );
-
-        k=(28*512);//14336;
-        //k=((0+28)<<10);//28672
-        for (a=0; a<iGLOBAL_SCREENHEIGHT; a++) {
-            for (b=0; b<iGLOBAL_SCREENWIDTH; b++) {
-                //*(RotatedImage+99+((a+28)<<9)+b)   =   *((byte *)bufferofs+(a*linewidth)+b);
-                // 99 is some offset value
-                k = ((a+28)<<10);
-                *(RotatedImage+(k)+b)   =   *((byte *)bufferofs+(a*linewidth)+b);
-                //*(RotatedImage+b)   =   *((byte *)bufferofs+(a*linewidth)+b);
-            }
-            //k+=512*2;
-        }
-    } else if ((masked == false)&&(iGLOBAL_SCREENWIDTH == 640)) {
-        DisableScreenStretch();
-        k=(28*512);//14336;
-        for (a=0; a<iGLOBAL_SCREENHEIGHT; a++) {
-            for (b=0; b<iGLOBAL_SCREENWIDTH; b++) {
-                k = ((a+28)<<10);
-                *(RotatedImage+(k)+b)   =   *((byte *)bufferofs+(a*linewidth)+b);
-            }
-        }
-
-    } else if ((masked == true)||(iGLOBAL_SCREENWIDTH == 320)) {
-        for (a=0; a<200; a++) {
-            for (b=0; b<320; b++)
-                *(RotatedImage+99+((a+28)<<9)+b)=*((byte *)bufferofs+(a*linewidth)+b);
-        }
+    {
+        rotwidth = iGLOBAL_SCREENWIDTH;
+        rotheight = iGLOBAL_SCREENHEIGHT;
+        if (iGLOBAL_SCREENWIDTH > 320)
+            DisableScreenStretch();
     }
 
+    for (rotshift = 0; (1<<rotshift) < rotwidth; rotshift++)
+        ;
+    RotatedImage = SafeMalloc(rotheight<<rotshift);
+    for (y = 0; y < rotheight; y++)
+        memcpy(RotatedImage+(y<<rotshift), (byte *)bufferofs+(y*linewidth), rotwidth);
 }
-/* copier liner af 1024 bredde
-a=0=14436 a=1=14848 a=2=15360 a=3=15872  -> 512 i difference
-*(RotatedImage+(512)+0) = bufferofs+(0*800)+0);
-*(RotatedImage+(512)+100) = bufferofs+(100*800)+0);
-*/
 
 //******************************************************************************
 //
@@ -2978,7 +3097,7 @@ extern boolean skipRotate;
 
 void RotateBuffer (int startangle, int endangle, int startscale, int endscale, int time)
 {   
-    int savetics;
+    unsigned savetics;
 
     //save off fastcounter
 
@@ -3160,80 +3279,119 @@ void RotateScreen(int startAngle, int endAngle, int startScale, int endScale, in
 //
 // DrawRotatedScreen
 //
+// Draws RotatedImage turned by angle and scaled by scale/FINEANGLES with its
+// centre at cx,cy.  Each row is clipped to the part that lands inside the
+// image first, so the row loops need no bounds tests, and the rows are
+// shared out between the job threads.
+//
 //******************************************************************************
 
-void DrawRotatedScreen(int cx, int cy, byte *destscreen, int angle, int scale, int masked)
-{   //ZXCV
-    int     c, s;
-    int     xst, xct;
-    int     y;
-
-    byte    * screen;
-    //int Xres = 320;//old value
-    //int Yres = 200;//old val
-
-    int Xr = iGLOBAL_SCREENWIDTH;//640;
-    int Yr = (iGLOBAL_SCREENHEIGHT);//400; //bna aaaa fix
-
-//	   SetTextMode (  );
-    c = FixedMulShift(scale,costable[angle],11);
-    s = FixedMulShift(scale,sintable[angle],11);
-
-//   c = c/2; //these values are to rotate degres or?
-//   s = s/2;
-//   xst & xct= start center values ;
-    if ((iGLOBAL_SCREENWIDTH == 320 )||(masked == true)) {
-        xst = (((-cx)*s)+(128<<16))-(cy*c);
-        xct = (((-cx)*c)+(256<<16)+(1<<18)-(1<<16))+(cy*s);
-    }
-    else if ((iGLOBAL_SCREENWIDTH == 640 )&&(masked == false)) {
-        xst = (((-cx)*s)+((268)<<16))-(cy*c);
-        xct = (((-cx)*c)+((317)<<16)+(1<<18)-(1<<16))+(cy*s);
-    }//y=268;x=317
-    else if ((iGLOBAL_SCREENWIDTH == 800 )&&(masked == false)) {
-        xst = (((-cx)*s)+((328)<<16))-(cy*c);
-        xct = (((-cx)*c)+((397)<<16)+(1<<18)-(1<<16))+(cy*s);
-    }//328 397
-    else if ((iGLOBAL_SCREENWIDTH == 1024 )&&(masked == false)) {
-	xst = (((-cx)*s)+((410)<<16))-(cy*c);// 1024/768=1.3333
-	xct = (((-cx)*c)+((500)<<16)+(1<<18)-(1<<16))+(cy*s);
-    }//388 397
-    else if ((iGLOBAL_SCREENWIDTH >= 1152) && (masked == false))
-    {
-        xst = (((-cx)*s)+((432)<<16))-(cy*c);
-	xct = (((-cx)*c)+((576)<<16)+(1<<18)-(1<<16))+(cy*s);
-    }
+typedef struct
+{
+    byte * dest;
+    int    cx, cy;
+    int    c, s;
+    int    masked;
+} rotjob_t;
 
-    mr_xstep=s;
-    mr_ystep=c;
+static long long FloorDiv (long long a, long long b)
+{
+    long long q = a/b;
 
+    if (((a%b) != 0) && ((a<0) != (b<0)))
+        q--;
+    return q;
+}
 
-    if ((iGLOBAL_SCREENWIDTH >= 800)&&(masked==0)) {
-        screen=destscreen+iGLOBAL_SCREENWIDTH;//bna aaaa fix
-    } else {
-        screen=destscreen;
-    }
+//
+// Narrows xa..xb to the x where 0 <= p0 + x*dp < limit
+//
+static void ClipRotatedSpan (long long p0, int dp, long long limit, int *xa, int *xb)
+{
+    long long lo, hi;
 
-    if (masked==0)
+    if (dp == 0)
     {
-        // paint hole 800x600 screen
+        if ((p0 < 0) || (p0 >= limit))
         {
-            mr_yfrac=xct;
-            mr_xfrac=xst;
-            for (y=0; y<Yr; y++,mr_xfrac+=c,mr_yfrac-=s)
-                DrawRotRow(Xr,screen+ylookup[y],RotatedImage);
+            *xa = 1;
+            *xb = 0;
         }
+        return;
+    }
+    if (dp > 0)
+    {
+        lo = -FloorDiv(p0, dp);
+        hi = FloorDiv(limit-1-p0, dp);
     }
     else
     {
+        lo = -FloorDiv((limit-1)-p0, -dp);
+        hi = FloorDiv(p0, -dp);
+    }
+    if (lo > *xa)
+        *xa = (lo > *xb) ? *xb+1 : (int)lo;
+    if (hi < *xb)
+        *xb = (hi < *xa) ? *xa-1 : (int)hi;
+}
+
+static void DrawRotatedRows (int first, int last, void * data)
+{
+    rotjob_t * job = (rotjob_t *)data;
+    long long  u0, v0;
+    int        xa, xb;
+    int        y;
+    byte     * row;
+
+    for (y = first; y < last; y++)
+    {
+        row = job->dest+ylookup[y];
+
+        // image position of pixel 0 of this row, 16.16
+        u0 = ((long long)(rotwidth/2)<<16) - (long long)job->cx*job->c - (long long)(y-job->cy)*job->s;
+        v0 = ((long long)(rotheight/2)<<16) - (long long)job->cx*job->s + (long long)(y-job->cy)*job->c;
+
+        xa = 0;
+        xb = iGLOBAL_SCREENWIDTH-1;
+        ClipRotatedSpan(u0, job->c, (long long)rotwidth<<16, &xa, &xb);
+        ClipRotatedSpan(v0, job->s, (long long)rotheight<<16, &xa, &xb);
+
+        if (job->masked == false)
         {
-            mr_yfrac=xct;
-            mr_xfrac=xst;
-            for (y=0; y<Yr; y++,mr_xfrac+=c,mr_yfrac-=s)
-                DrawMaskedRotRow(Xr,screen+ylookup[y],RotatedImage);
+            if (xa > xb)
+            {
+                memset(row, 0, iGLOBAL_SCREENWIDTH);
+                continue;
+            }
+            memset(row, 0, xa);
+            memset(row+xb+1, 0, iGLOBAL_SCREENWIDTH-1-xb);
         }
+        if (xa > xb)
+            continue;
+
+        if (job->masked == false)
+            DrawRotRow(xb-xa+1, row+xa, RotatedImage, rotshift,
+                       (unsigned)(u0+(long long)xa*job->c), (unsigned)(v0+(long long)xa*job->s),
+                       job->c, job->s);
+        else
+            DrawMaskedRotRow(xb-xa+1, row+xa, RotatedImage, rotshift,
+                             (unsigned)(u0+(long long)xa*job->c), (unsigned)(v0+(long long)xa*job->s),
+                             job->c, job->s);
     }
+}
 
+void DrawRotatedScreen(int cx, int cy, byte *destscreen, int angle, int scale, int masked)
+{
+    rotjob_t job;
+
+    job.dest = destscreen;
+    job.cx = cx;
+    job.cy = cy;
+    job.c = FixedMulShift(scale,costable[angle],11);
+    job.s = FixedMulShift(scale,sintable[angle],11);
+    job.masked = masked;
+
+    JOB_Run(DrawRotatedRows, iGLOBAL_SCREENHEIGHT, &job);
 }
 
 
@@ -5526,160 +5684,60 @@ void  DrawMapPost (int height, byte * src, byte * buf)
     }
 }
 
-void DrawRotRow(int count, byte * dest, byte * src)
+//
+// u and v are the 16.16 image column and row of the first pixel, every
+// pixel of the run must land inside the image
+//
+void DrawRotRow(int count, byte * dest, byte * src, int shift,
+                unsigned u, unsigned v, int du, int dv)
 {
-    unsigned eax, ecx, edx;
-//	unsigned a, b, c,d;
-    byte * srctmp;
-    byte * desttmp;
-
-    ecx = mr_yfrac;
-    edx = mr_xfrac;
-
-    if ((iGLOBAL_SCREENWIDTH == 320)||(iG_masked==true))
+#ifdef __SSE2__
+    if (count >= 4)
     {
-        while (count--) {
-            eax = edx >> 16;
-            if (eax < 256 && (ecx >> 16) < 512) {
-                eax = (eax << 9) | ((ecx << 7) >> (32-9));
-            } else {
-                eax = 0;
-            }
-
-            *dest++ = src[eax];
-
-            edx += mr_xstep;
-            ecx += mr_ystep;
-        }
-    } else if (iGLOBAL_SCREENWIDTH == 640) {
-        while (count--) {
-            eax = edx >> 16;
-            if (eax < (256*2.0) && (ecx >> 16) < (512*1.8)) {
-                eax = (eax << 10) | ((ecx << 6) >> (32-10));
-            } else {
-                eax = 0;
-            }
-
-            *dest++ = src[eax];
-
-            edx += mr_xstep;
-            ecx += mr_ystep;
-        }
-    } else if (iGLOBAL_SCREENWIDTH == 800) {
-        srctmp = src;
-        desttmp = dest;
-
-        desttmp -= (iGLOBAL_SCREENWIDTH*1);
-
-        ecx = mr_yfrac;
-        edx = mr_xfrac;
-        //count = 800
-//zxcv
-        while (count--) {
-            eax = edx >> 16;//edx=4146069504 eax=63264  edx/eax = 65536->0x10000
-
-            //a=(eax << 9); //=eax*512
-            //a=(eax << 7); //=eax*128
-            //a=512|128; = 640;
-            //SetTextMode (  );
-            //a=(ecx >> 16);//ecx=4102225920 a=62595   ecx/65536 = 62595
-
-            //         Y-dir                    x-dir
-            if (eax < (256*2.5) && (ecx >> 16) < (512*2)) {
-                //eax = (eax << 9) | ((ecx << 7) >> (32-9));
-                eax = (eax << 10) | ((ecx << 6) >> (32-10));
-                /*		eax = (eax * 512*2) ;
-                							//(23)
-                		eax += 	 ((ecx ) >> (32-9));//ecx=196608
-                		*/
-            } else {
-                eax = 0;
-
-
-            }
-            //desttmp -= centeroffset;
-            *desttmp++ = srctmp[eax];
-            //*desttmp++ = srctmp[eax];
-
-            edx += mr_xstep;
-            ecx += mr_ystep;
-        }
-
-    }
-    else if (iGLOBAL_SCREENWIDTH >= 1024) {
-        srctmp = src;
-        desttmp = dest;
-
-        desttmp -= (iGLOBAL_SCREENWIDTH*1);
-
-/*
-        ecx = mr_yfrac;
-        edx = mr_xfrac;
-*/
-	while (count--) {
-            eax = edx >> 16;
-            if (eax < (256*3.1) && (ecx >> 16) < (512*2.0)) {
-                eax = (eax << 10) | ((ecx << 6) >> (32-10));
-            } else {
-		eax = 0;
-            }
-			
-            *desttmp++ = srctmp[eax];
-			
-            edx += mr_xstep;
-            ecx += mr_ystep;
+        __m128i uu, vv, du4, dv4, sh;
+        union { __m128i v; unsigned i[4]; } index;
+
+        uu  = _mm_setr_epi32(u, u+du, u+2*du, u+3*du);
+        vv  = _mm_setr_epi32(v, v+dv, v+2*dv, v+3*dv);
+        du4 = _mm_set1_epi32(du*4);
+        dv4 = _mm_set1_epi32(dv*4);
+        sh  = _mm_cvtsi32_si128(shift);
+        while (count >= 4)
+        {
+            index.v = _mm_add_epi32(_mm_sll_epi32(_mm_srli_epi32(vv,16),sh),
+                                    _mm_srli_epi32(uu,16));
+            dest[0] = src[index.i[0]];
+            dest[1] = src[index.i[1]];
+            dest[2] = src[index.i[2]];
+            dest[3] = src[index.i[3]];
+            dest += 4;
+            count -= 4;
+            uu = _mm_add_epi32(uu, du4);
+            vv = _mm_add_epi32(vv, dv4);
         }
+        u = _mm_cvtsi128_si32(uu);
+        v = _mm_cvtsi128_si32(vv);
     }
-    else
-    {
-        srctmp = src;
-        desttmp = dest;
-
-        desttmp -= (iGLOBAL_SCREENWIDTH*1);
-
-/*
-        ecx = mr_yfrac;
-        edx = mr_xfrac;
-*/
-	while (count--) {
-            eax = edx >> 16;
-            if (eax < (256*4) && (ecx >> 16) < (512*4)) {
-                eax = (eax << 10) | ((ecx << 6) >> (32-10));
-            } else {
-		eax = 0;
-            }
-			
-            *desttmp++ = srctmp[eax];
-			
-            edx += mr_xstep;
-            ecx += mr_ystep;
-        }
-    
-    
+#endif
+    while (count--) {
+        *dest++ = src[((v>>16)<<shift)+(u>>16)];
+        u += du;
+        v += dv;
     }
 }
 
-void DrawMaskedRotRow(int count, byte * dest, byte * src)
+void DrawMaskedRotRow(int count, byte * dest, byte * src, int shift,
+                      unsigned u, unsigned v, int du, int dv)
 {
-    unsigned eax;
-    unsigned xfrac, yfrac;
-
-    xfrac = mr_xfrac;
-    yfrac = mr_yfrac;
+    byte texel;
 
     while (count--) {
-        eax = xfrac >> 16;
-        if (eax < 256 && (yfrac >> 16) < 512) {
-            eax = (eax << 9) | ((yfrac << 7) >> (32-9));
-        } else {
-            eax = 0;
-        }
-
-        if (src[eax] != 0xff) *dest = src[eax];
+        texel = src[((v>>16)<<shift)+(u>>16)];
+        if (texel != 0xff)
+            *dest = texel;
         dest++;
-
-        xfrac += mr_xstep;
-        yfrac += mr_ystep;
+        u += du;
+        v += dv;
     }
 }
 
@@ -5693,7 +5751,7 @@ void DrawSkyPost (byte * buf, byte * src, int height)
             *buf = shadingtable[*src];
 
             buf += linewidth;
-            src = orig_src + (++i*200/iGLOBAL_SCREENHEIGHT);
+            src = orig_src + (++i*200/renderheight);
         }
         //
     }
@@ -5721,7 +5779,7 @@ void RefreshClear (void)
 {
     int start, base;
 
-    memset(spotvis, 0, sizeof(spotvis));
+    ClearVisibleSpots();
 
     if (fandc) {
         return;
@@ -25,7 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //***************************************************************************
 
 
-#define MAXVISIBLE              256
+#define MAXVISIBLE              256   // initial size of vislist, grown as needed
 
 extern int whereami;
 
@@ -48,6 +48,21 @@ typedef struct
 
 extern  word             tilemap[MAPSIZE][MAPSIZE];    // wall values only
 extern  byte             spotvis[MAPSIZE][MAPSIZE];
+extern  word             visiblespots[MAPSIZE*MAPSIZE]; // tiles set in spotvis
+extern  int              numvisiblespots;
+
+//
+// Mark a tile visible this frame, remembering it so the sprite gather
+// and the next clear only touch tiles that were seen
+//
+#define SetSpotVisible(x,y)                                       \
+   {                                                              \
+   if (!spotvis[(x)][(y)])                                        \
+      {                                                           \
+      spotvis[(x)][(y)]=1;                                        \
+      visiblespots[numvisiblespots++]=((x)*MAPSIZE)+(y);          \
+      }                                                           \
+   }
 
 extern int tics;
 extern int wstart;
@@ -72,12 +87,14 @@ extern fixed   viewsin,viewcos;
 // ray tracing variables
 //
 
-extern visobj_t vislist[MAXVISIBLE];
+extern visobj_t *vislist;
 extern visobj_t *visptr,*visstep,*farthest;
+extern int      maxvisible;
 
 extern long     xintercept,yintercept;
 extern byte     mapseen[MAPSIZE][MAPSIZE];
 extern unsigned long * lights;
+extern byte          * tilelights;
 
 extern int hp_startfrac;
 extern int hp_srcstep;
@@ -97,17 +114,28 @@ extern  int firstcoloffset;
 //=========================== macros =============================
 
 #define LightSourceAt(x,y)    (*(lights+((x)<<7)+(y)))
-#define SetLight(x,y,level)   (LightSourceAt((x),(y))|=(unsigned long)(level))
+#define SetLight(x,y,level)   (LightSourceAt((x),(y))|=(unsigned long)(level),CacheTileLight((x),(y)))
+#define ClearLight(x,y)       (LightSourceAt((x),(y))=0,CacheTileLight((x),(y)))
+
+//
+// Light source level at one of the eight points along a tile, intercept
+// is the nibble shift the drawing code takes from the fractional position
+//
+#define LightLevelAt(x,y,intercept) (*(tilelights+((((x)<<7)+(y))<<3)+((intercept)>>2)))
 
 //=========================== functions =============================
 
 void  BuildTables (void);
+void  SetVisibleListSize (int size);
+void  ResetVisibleList (void);
+boolean VisibleRoom (void);
 void  CalcTics (void);
 void  ThreeDRefresh (void);
 void  FlipPage ( void );
 void  TurnShakeOff( void );
 void  AdaptDetail ( void );
 int   CalcHeight (void);
+void  CacheTileLight (int x, int y);
 void  DoLoadGameSequence( void );
 void RotateBuffer (int startangle, int endangle, int startscale, int endscale, int time);
 void RotateScreenScaleFloat(float startAngle, float endAngle, float startScale, float endScale, int time, boolean fadeOut, boolean drawPlayScreen);
@@ -26,8 +26,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 void DrawSkyPost (byte * buf, byte * src, int height);
 void DrawRow(int count, byte * dest, byte * src);
-void DrawRotRow(int count, byte * dest, byte * src);
-void DrawMaskedRotRow(int count, byte * dest, byte * src);
+void DrawRotRow(int count, byte * dest, byte * src, int shift,
+                unsigned u, unsigned v, int du, int dv);
+void DrawMaskedRotRow(int count, byte * dest, byte * src, int shift,
+                      unsigned u, unsigned v, int du, int dv);
 
 #endif
 
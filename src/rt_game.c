@@ -151,6 +151,46 @@ static int oldpercenthealth;
 
 static int playeruniformcolor;
 
+//
+// Retained status layers
+//
+// The transparent player stats are drawn over the view every refresh, so
+// they are composed once into statslayer and kept as a list of opaque spans
+// until one of the values they show changes.  The status bars are kept as a
+// copy of their rows, which ScreenShake puts back instead of redrawing every
+// widget.  Any status drawer invalidates that copy.
+//
+
+typedef struct
+{
+    int percenthealth;
+    int armed;
+    int weapon;
+    int ammo;
+    int infinite;
+    int health_y;
+    int ammo_y;
+} statskey_t;
+
+typedef struct
+{
+    int offset;
+    int length;
+} statspan_t;
+
+#define MAXSTATSPANS 2048
+
+static byte      *statslayer = NULL;
+static statspan_t statspans[MAXSTATSPANS];
+static int        numstatspans;
+static statskey_t statskey;
+static boolean    statsvalid = false;
+
+static byte      *statusbars = NULL;
+static boolean    statusbarsvalid = false;
+static int        statusbarflags;
+static int        statusbarrows;
+
 #define NUMBONUSES   11
 #define BONUSBONUS   100000
 
@@ -180,6 +220,8 @@ void V_ReDrawBkgnd (int x, int y, int width, int height, boolean shade)
         mask,
         m;
 
+    statusbarsvalid = false;
+
     m = (x&3);
     mask = (1 << m);
 
@@ -360,6 +402,8 @@ void SetupPlayScreen
 
 void GameMemToScreen(pic_t *source, int x, int y, int bufferofsonly)
 {
+    statusbarsvalid = false;
+
     if ( bufferofsonly )
     {
         VL_MemToScreen( ( byte * )&source->data, source->width,
@@ -387,6 +431,8 @@ void DrawPlayScreen (boolean bufferofsonly)
     
     int    shapenum;
 
+    statusbarsvalid = false;
+
     //figure out where the middle point of the status bar should be for top bar
     topBarCenterOffsetX = (iGLOBAL_SCREENWIDTH - 320) >> 1;
     
@@ -1004,6 +1050,8 @@ void DrawGameString (int x, int y, const char * str, boolean bufferofsonly)
 {
     byte *tempbuf;
 
+    statusbarsvalid = false;
+
     px=x;
     py=y;
 
@@ -1650,6 +1698,8 @@ void DrawMPPic (int xpos, int ypos, int width, int height, int heightmod, byte *
     int planes;
     byte pixel;
 
+    statusbarsvalid = false;
+
     olddest = ylookup[ypos] + xpos;
 
     for (planes = 0; planes < 4; planes++)
@@ -1715,6 +1765,8 @@ void DrawColoredMPPic (int xpos, int ypos, int width, int height, int heightmod,
     byte pixel;
     byte * cmap;
 
+    statusbarsvalid = false;
+
     cmap=playermaps[color]+(1<<12);
 
     olddest = ylookup[ypos] + xpos;
@@ -1870,6 +1922,8 @@ void DrawPPic (int xpos, int ypos, int width, int height, byte *src, int num, bo
     int k;
     int amt;
 
+    statusbarsvalid = false;
+
     if (up)
         amt = 8;
     else
@@ -2110,6 +2164,126 @@ void SingleDrawPPic (int xpos, int ypos, int width, int height, byte *src, int n
 
 
 
+//****************************************************************************
+//
+// DrawStatsPics ()
+//
+// Draws the transparent health and ammo pics with their screen position
+// taken relative to bufferofs - screenofs
+//
+//****************************************************************************
+
+static void DrawStatsPics (int health_y, int ammo_y)
+{
+    if ( oldpercenthealth < 4 )
+    {
+        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
+                        ( byte * )&health[ 3 ]->data, oldpercenthealth, true);
+    }
+    else if ( oldpercenthealth < 5 )
+    {
+        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
+                        ( byte * )&health[ 4 ]->data, oldpercenthealth, true );
+    }
+    else
+    {
+        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
+                        ( byte * )&health[ 5 ]->data, oldpercenthealth, true );
+    }
+
+    if ( ARMED( consoleplayer ) )
+    {
+        if ((locplayerstate->new_weapon < wp_bazooka) ||
+                (locplayerstate->new_weapon == wp_godhand) ||
+                (gamestate.BattleOptions.Ammo == bo_infinite_shots )
+           )
+
+        {
+            SingleDrawPPic( iGLOBAL_AMMO_X - 16, ammo_y, 24 >> 2, 16,
+                            ( byte * )&ammo[13]->data, 1, true );
+        }
+#if (SHAREWARE == 0)
+        else if ( locplayerstate->new_weapon == wp_dog )
+        {
+            SingleDrawPPic( iGLOBAL_AMMO_X - 16, ammo_y + 1, 24 >> 2, 16,
+                            ( byte * )&ammo[25]->data, 1, true );
+        }
+#endif
+        else
+        {
+            SingleDrawPPic( iGLOBAL_AMMO_X, ammo_y + 1, 8 >> 2, 16,
+                            ( byte * )&ammo[13 + locplayerstate->new_weapon]->data,
+                            locplayerstate->ammo, false );
+        }
+    }
+}
+
+
+//****************************************************************************
+//
+// ComposeStats ()
+//
+// Draws the stats into statslayer and collects its opaque spans
+//
+//****************************************************************************
+
+static void ComposeStats (int health_y, int ammo_y)
+{
+    byte *tempbuf;
+    byte *row;
+    int   top;
+    int   bottom;
+    int   x;
+    int   y;
+    int   start;
+
+    // one spare row, the ammo pics reach a row below their y+16
+    if (statslayer == NULL)
+        statslayer = SafeMalloc (screensize + linewidth);
+
+    top    = min (health_y, ammo_y);
+    bottom = max (health_y, ammo_y + 1) + 16;
+    memset (statslayer + top*linewidth, 255, (bottom - top)*linewidth);
+
+    tempbuf = bufferofs;
+    bufferofs = statslayer + screenofs;
+    DrawStatsPics (health_y, ammo_y);
+    bufferofs = tempbuf;
+
+    if (bottom > iGLOBAL_SCREENHEIGHT)
+        bottom = iGLOBAL_SCREENHEIGHT;
+
+    numstatspans = 0;
+    statsvalid = false;
+
+    for (y = top; y < bottom; y++)
+    {
+        row = statslayer + y*linewidth;
+        for (x = 0; x < iGLOBAL_SCREENWIDTH; )
+        {
+            if (row[x] == 255)
+            {
+                x++;
+                continue;
+            }
+
+            start = x;
+            while ((x < iGLOBAL_SCREENWIDTH) && (row[x] != 255))
+                x++;
+
+            if (numstatspans == MAXSTATSPANS)
+                return;
+
+            statspans[numstatspans].offset = y*linewidth + start;
+            statspans[numstatspans].length = x - start;
+            numstatspans++;
+        }
+    }
+
+    statsvalid = true;
+}
+
+
 //****************************************************************************
 //
 // DrawStats ()
@@ -2122,9 +2296,12 @@ void DrawStats
 )
 
 {
+    statskey_t key;
+    byte *dest;
     int percenthealth;
     int health_y;
     int ammo_y;
+    int i;
 
     if ( ( !SHOW_PLAYER_STATS() ) || ( playstate == ex_died ) ||
             ( locplayerstate->health <= 0 ) )
@@ -2165,46 +2342,33 @@ void DrawStats
         oldpercenthealth = 10;
     }
 
-    if ( oldpercenthealth < 4 )
-    {
-        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
-                        ( byte * )&health[ 3 ]->data, oldpercenthealth, true);
-    }
-    else if ( oldpercenthealth < 5 )
+    memset (&key, 0, sizeof(key));
+    key.percenthealth = oldpercenthealth;
+    key.armed         = ARMED( consoleplayer ) ? 1 : 0;
+    key.weapon        = locplayerstate->new_weapon;
+    key.ammo          = locplayerstate->ammo;
+    key.infinite      = ( gamestate.BattleOptions.Ammo == bo_infinite_shots );
+    key.health_y      = health_y;
+    key.ammo_y        = ammo_y;
+
+    if ( ( statsvalid == false ) || memcmp( &key, &statskey, sizeof( key ) ) )
     {
-        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
-                        ( byte * )&health[ 4 ]->data, oldpercenthealth, true );
+        statskey = key;
+        ComposeStats( health_y, ammo_y );
     }
-    else
+
+    // Too many spans to keep, draw the pics directly
+    if ( statsvalid == false )
     {
-        SingleDrawPPic( iGLOBAL_HEALTH_X - 16, health_y, 8 >> 2, 16,
-                        ( byte * )&health[ 5 ]->data, oldpercenthealth, true );
+        DrawStatsPics( health_y, ammo_y );
+        return;
     }
 
-    if ( ARMED( consoleplayer ) )
+    dest = bufferofs - screenofs;
+    for ( i = 0; i < numstatspans; i++ )
     {
-        if ((locplayerstate->new_weapon < wp_bazooka) ||
-                (locplayerstate->new_weapon == wp_godhand) ||
-                (gamestate.BattleOptions.Ammo == bo_infinite_shots )
-           )
-
-        {
-            SingleDrawPPic( iGLOBAL_AMMO_X - 16, ammo_y, 24 >> 2, 16,
-                            ( byte * )&ammo[13]->data, 1, true );
-        }
-#if (SHAREWARE == 0)
-        else if ( locplayerstate->new_weapon == wp_dog )
-        {
-            SingleDrawPPic( iGLOBAL_AMMO_X - 16, ammo_y + 1, 24 >> 2, 16,
-                            ( byte * )&ammo[25]->data, 1, true );
-        }
-#endif
-        else
-        {
-            SingleDrawPPic( iGLOBAL_AMMO_X, ammo_y + 1, 8 >> 2, 16,
-                            ( byte * )&ammo[13 + locplayerstate->new_weapon]->data,
-                            locplayerstate->ammo, false );
-        }
+        memcpy( dest + statspans[ i ].offset, statslayer + statspans[ i ].offset,
+                statspans[ i ].length );
     }
 }
 
@@ -2672,6 +2836,8 @@ void GM_MemToScreen (byte *source, int width, int height, int x, int y)
     byte *screen1, *screen2, *screen3;
     int  plane;
 
+    statusbarsvalid = false;
+
     dest = ylookup[y]+x;
 
     mask = 1 << (x&3);
@@ -2709,6 +2875,53 @@ void GM_MemToScreen (byte *source, int width, int height, int x, int y)
 }
 
 
+//******************************************************************************
+//
+// RepaintPlayScreen ()
+//
+// Puts the status bars back after the view was shifted, from the saved rows
+// when nothing drew on them since they were saved
+//
+//******************************************************************************
+
+static void RepaintPlayScreen (void)
+{
+    int rows;
+
+    rows = 16 * hudRescaleFactor;
+
+    if ( BATTLEMODE || demoplayback || SHOW_KILLS() )
+    {
+        DrawPlayScreen (true);
+        return;
+    }
+
+    if ( statusbarsvalid && ( statusbarflags == StatusBar ) &&
+            ( statusbarrows == rows ) )
+    {
+        if ( SHOW_TOP_STATUS_BAR() )
+            memcpy (bufferofs, statusbars, rows*linewidth);
+        if ( SHOW_BOTTOM_STATUS_BAR() )
+            memcpy (bufferofs + ylookup[iGLOBAL_SCREENHEIGHT - rows],
+                    statusbars + rows*linewidth, rows*linewidth);
+        return;
+    }
+
+    DrawPlayScreen (true);
+
+    if (statusbars == NULL)
+        statusbars = SafeMalloc (screensize);
+
+    memcpy (statusbars, bufferofs, rows*linewidth);
+    memcpy (statusbars + rows*linewidth,
+            bufferofs + ylookup[iGLOBAL_SCREENHEIGHT - rows], rows*linewidth);
+
+    statusbarflags  = StatusBar;
+    statusbarrows   = rows;
+    statusbarsvalid = true;
+}
+
+
 //==========================================================================
 
 /*
@@ -2760,7 +2973,7 @@ void ScreenShake (void)
         }
         //fix for play screen accidentally being drawn during transmitter explosion cinematic
         if (playstate != ex_gameover) 
-            DrawPlayScreen(true);//repaint ammo and life stat
+            RepaintPlayScreen();//repaint ammo and life stat
 
     }
 }
@@ -0,0 +1,211 @@
+/*
+Copyright (C) 1994-1995  Apogee Software, Ltd.
+Copyright (C) 2002-2015  icculus.org, GNU/Linux port
+Copyright (C) 2017-2018  Steven LeVesque
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+//***************************************************************************
+//
+//   RT_JOBS.C - Worker threads for splitting per-row work
+//
+//   JOB_Run cuts the items into one slice per thread, runs the first
+//   slice on the calling thread and returns once every slice is done.
+//
+//***************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "rt_def.h"
+#include "rt_jobs.h"
+#include "rt_util.h"
+
+
+//****************************************************************************
+//
+// GLOBALS
+//
+//****************************************************************************
+
+#define MAXWORKERS   15       // threads besides the caller
+#define MINJOBITEMS  16       // smaller jobs aren't worth waking anyone
+
+typedef struct
+{
+    SDL_Thread * thread;
+    SDL_sem    * start;
+    int          first;
+    int          last;
+} worker_t;
+
+static boolean    jobsstarted = false;
+static boolean    jobsquit;
+static int        numworkers;
+static worker_t   workers[MAXWORKERS];
+static SDL_sem  * jobsdone;
+static jobfunc_t  jobfunc;
+static void     * jobdata;
+
+
+//****************************************************************************
+//
+// JobWorker ()
+//
+//****************************************************************************
+
+static int JobWorker (void * data)
+{
+    worker_t * worker = (worker_t *)data;
+
+    while (1)
+    {
+        SDL_SemWait (worker->start);
+        if (jobsquit == true)
+            break;
+        jobfunc (worker->first, worker->last, jobdata);
+        SDL_SemPost (jobsdone);
+    }
+    return 0;
+}
+
+
+//****************************************************************************
+//
+// JOB_Startup ()
+//
+// One worker per extra core.  Without threads everything runs on the
+// caller, so failing to start workers is not an error.
+//
+//****************************************************************************
+
+void JOB_Startup ( void )
+{
+    int i;
+    int cpus;
+
+    if (jobsstarted == true)
+        return;
+    jobsstarted = true;
+    jobsquit = false;
+
+    cpus = SDL_GetCPUCount ();
+    numworkers = 0;
+    jobsdone = SDL_CreateSemaphore (0);
+    if (jobsdone == NULL)
+        return;
+
+    for (i = 0; (i < cpus-1) && (i < MAXWORKERS); i++)
+    {
+        workers[i].start = SDL_CreateSemaphore (0);
+        if (workers[i].start == NULL)
+            break;
+        workers[i].thread = SDL_CreateThread (JobWorker, "JobWorker", &workers[i]);
+        if (workers[i].thread == NULL)
+        {
+            SDL_DestroySemaphore (workers[i].start);
+            break;
+        }
+        numworkers++;
+    }
+}
+
+
+//****************************************************************************
+//
+// JOB_Shutdown ()
+//
+//****************************************************************************
+
+void JOB_Shutdown ( void )
+{
+    int i;
+
+    if (jobsstarted == false)
+        return;
+    jobsstarted = false;
+
+    jobsquit = true;
+    for (i = 0; i < numworkers; i++)
+        SDL_SemPost (workers[i].start);
+    for (i = 0; i < numworkers; i++)
+    {
+        SDL_WaitThread (workers[i].thread, NULL);
+        SDL_DestroySemaphore (workers[i].start);
+    }
+    numworkers = 0;
+
+    if (jobsdone != NULL)
+        SDL_DestroySemaphore (jobsdone);
+    jobsdone = NULL;
+}
+
+
+//****************************************************************************
+//
+// JOB_NumThreads ()
+//
+// Threads a job is split across, counting the caller
+//
+//****************************************************************************
+
+int JOB_NumThreads ( void )
+{
+    JOB_Startup ();
+    return numworkers+1;
+}
+
+
+//****************************************************************************
+//
+// JOB_Run ()
+//
+//****************************************************************************
+
+void JOB_Run ( jobfunc_t func, int count, void * data )
+{
+    int i;
+    int slices;
+    int first;
+    int size;
+
+    JOB_Startup ();
+
+    slices = numworkers+1;
+    if (count < slices*MINJOBITEMS)
+        slices = count/MINJOBITEMS;
+    if (slices <= 1)
+    {
+        func (0, count, data);
+        return;
+    }
+
+    jobfunc = func;
+    jobdata = data;
+
+    // The caller keeps slice 0, the workers take the rest
+    size = count/slices;
+    first = size + (count%slices);
+    for (i = 0; i < slices-1; i++)
+    {
+        workers[i].first = first;
+        workers[i].last = first+size;
+        first += size;
+        SDL_SemPost (workers[i].start);
+    }
+
+    func (0, size + (count%slices), data);
+
+    for (i = 0; i < slices-1; i++)
+        SDL_SemWait (jobsdone);
+}
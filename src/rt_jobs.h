@@ -0,0 +1,41 @@
+/*
+Copyright (C) 1994-1995  Apogee Software, Ltd.
+Copyright (C) 2002-2015  icculus.org, GNU/Linux port
+Copyright (C) 2017-2018  Steven LeVesque
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+//***************************************************************************
+//
+//   RT_JOBS.H - Worker threads for splitting per-row work
+//
+//***************************************************************************
+
+#ifndef _rt_jobs_public
+#define _rt_jobs_public
+
+#include "rt_def.h"
+
+//
+// A job is called with a range [first,last) of the items it was given
+// and the data pointer passed to JOB_Run.  Ranges never overlap, so a
+// job writing only to its own rows needs no locking.
+//
+typedef void (*jobfunc_t) (int first, int last, void * data);
+
+void JOB_Startup ( void );
+void JOB_Shutdown ( void );
+void JOB_Run ( jobfunc_t func, int count, void * data );
+int  JOB_NumThreads ( void );
+
+#endif
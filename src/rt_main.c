@@ -68,6 +68,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "cin_main.h"
 #include "rottnet.h"
 #include "rt_scale.h"
+#include "rt_sync.h"
+#include "rt_prof.h"
+#include "rt_jobs.h"
 
 #include "music.h"
 #include "fx_man.h"
@@ -114,6 +117,10 @@ static boolean turbo;
 static int NoWait;
 static int startlevel=0;
 static int demonumber=-1;
+static int playdemo=-1;
+static boolean rendermusic=false;
+static char *hashrecordname=NULL;
+static char *hashverifyname=NULL;
 
 char CWD[40];                          // curent working directory
 static boolean quitactive = false;
@@ -230,6 +237,10 @@ int main (int argc, char *argv[])
  
     Z_Init(50000,1000000);
 
+    // The hash verifier loads its golden stream into zone memory
+    if ((hashrecordname != NULL) || (hashverifyname != NULL))
+        StartupStateHash (hashrecordname, hashverifyname);
+
     IN_Startup ();
 
     InitializeGameCommands();
@@ -292,6 +303,8 @@ int main (int argc, char *argv[])
             MU_Startup(false);
             if (!quiet)
                 printf( "%s\n", MUSIC_ErrorString( MUSIC_Error ) );
+            if (rendermusic == true)
+                MU_RenderSongCache();
         }
 
         Init_Tables ();
@@ -463,7 +476,8 @@ void CheckCommandLineParameters( void )
                         "TRANSPORT","DOPEFISH","SCREENSHOTS",
                         "MONO","MAPSTATS","TILESTATS","VER","net",
                         "PAUSE","SOUNDSETUP","WARP","IS8250","ENABLEVR",
-                        "TIMELIMIT","MAXTIMELIMIT","NOECHO","DEMOEXIT","QUIET",NULL
+                        "TIMELIMIT","MAXTIMELIMIT","NOECHO","DEMOEXIT","QUIET",
+                        "PLAYDEMO","HASHRECORD","HASHVERIFY","TELEMETRY","MUSICCACHE","RENDERMUSIC","AUDIOFILE","DYNRES",NULL
                        };
     int i,n;
 
@@ -528,6 +542,20 @@ void CheckCommandLineParameters( void )
         printf ("   ENABLEVR   - Enable VR helmet input devices\n");
         printf ("   NOECHO     - Turn off sound reverb\n");
         printf ("   DEMOEXIT   - Exit program when demo is terminated\n");
+        printf ("   PLAYDEMO   - Play a demo instead of the title sequence\n");
+        printf ("                next parameter is demo number\n");
+        printf ("   HASHRECORD - Write a per-tic game state hash stream\n");
+        printf ("                next parameter is hash filename\n");
+        printf ("   HASHVERIFY - Headless check of the game against a hash stream\n");
+        printf ("                next parameter is hash filename\n");
+        printf ("   TELEMETRY  - Time game subsystems, shown with the HUD\n");
+        printf ("                and printed at exit\n");
+        printf ("   MUSICCACHE - Cache each song as PCM the first time it plays\n");
+        printf ("   RENDERMUSIC- Pre-render the music cache at startup\n");
+        printf ("   AUDIOFILE  - Mix sound to a WAV file instead of the device\n");
+        printf ("                next parameter is filename, or null\n");
+        printf ("   DYNRES     - Scale the 3D view resolution to hold a refresh time\n");
+        printf ("                next parameter is the target in microseconds\n");
         printf ("   WARP       - Warp to specific ROTT level\n");
         printf ("                next parameter is level to start on\n");
         printf ("   TIMELIMIT  - Play ROTT in time limit mode\n");
@@ -716,6 +744,36 @@ void CheckCommandLineParameters( void )
         case 21:
             quiet = true;
             break;
+        case 22:
+            playdemo = ParseNum(_argv[i + 1]);
+            break;
+        case 23:
+            hashrecordname = _argv[i + 1];
+            break;
+        case 24:
+            hashverifyname = _argv[i + 1];
+            // Verification runs without a display or sound device
+            SDL_setenv ("SDL_VIDEODRIVER", "dummy", 0);
+            NoSound = true;
+            demoexit = true;
+            break;
+        case 25:
+            PROF_Startup ();
+            break;
+        case 26:
+            musiccache = true;
+            break;
+        case 27:
+            rendermusic = true;
+            break;
+        case 28:
+            FX_SetOutputFile (_argv[i + 1]);
+            break;
+        case 29:
+            dynamicresolution = true;
+            if ((i + 1 < _argc) && (ParseNum (_argv[i + 1]) > 0))
+                dynamictarget = ParseNum (_argv[i + 1]);
+            break;
         }
     }
 }
@@ -1103,7 +1161,14 @@ void GameLoop (void)
             BATTLE_Shutdown();
             MU_StartSong(song_title);
             EnableScreenStretch();
-            if ((NoWait==false)&&(!modemgame))
+            if (playdemo != -1)
+            {
+                if (DemoExists (playdemo) == false)
+                    Error ("Demo %d not found\n", playdemo);
+                ingame=true;
+                LoadDemo (playdemo);
+            }
+            else if ((NoWait==false)&&(!modemgame))
             {
                 byte dimpal[768];
                 int i;
@@ -1492,6 +1557,14 @@ void GameLoop (void)
             break;
 
         case ex_demodone:
+            if (playdemo != -1)
+            {
+                if (demoexit == true)
+                {
+                    QuitGame();
+                }
+                playdemo = -1;
+            }
             ingame=false;
             ShutdownClientControls();
             TurnShakeOff();
@@ -1594,12 +1667,14 @@ void ShutDown ( void )
 //      }
 
     ShutdownClientControls();
+    ShutdownStateHash();
     I_ShutdownKeyboard();
     ShutdownGameCommands();
     MU_Shutdown();
     I_ShutdownTimer();
     SD_Shutdown();
     IN_Shutdown ();
+    JOB_Shutdown ();
     ShutdownSoftError ();
     Z_ShutDown();
 //   _settextcursor (0x0607);
@@ -1619,6 +1694,8 @@ void QuitGame ( void )
     
     PrintMapStats();
     PrintTileStats();
+    ShutdownStateHash();
+    PROF_Dump();
     SetTextMode();
 
     ClearScanCodes();
@@ -1674,7 +1751,9 @@ extern boolean enableZomROTT;
 void UpdateGameObjects ( void )
 {
     int j;
-    volatile int atime;
+    volatile unsigned atime;
+    unsigned ptime;
+    int numtics;
     objtype * ob,*temp;
     battle_status BattleStatus;
 
@@ -1694,19 +1773,29 @@ void UpdateGameObjects ( void )
 
     UpdateClientControls ();
 
-
+    numtics = 0;
     while (oldpolltime<oldtime)
     {
         UpdateClientControls ();
+        SD_Update ();
+        numtics++;
+        ptime = PROF_Time();
         MoveDoors();
+        ptime = PROF_Mark(prof_doors, ptime);
         ProcessElevators();
+        ptime = PROF_Mark(prof_elevators, ptime);
         MovePWalls();
+        ptime = PROF_Mark(prof_pushwalls, ptime);
         UpdateLightning ();
+        ptime = PROF_Mark(prof_lightning, ptime);
         TriggerStuff();
+        ptime = PROF_Mark(prof_triggers, ptime);
         CheckCriticalStatics();
+        ptime = PROF_Mark(prof_statics, ptime);
         if (enableZomROTT && gamestate.killcount > 0)
         {
             ResurrectEnemies();
+            ptime = PROF_Mark(prof_resurrect, ptime);
         }
         
         for(j=0; j<numclocks; j++)
@@ -1714,14 +1803,17 @@ void UpdateGameObjects ( void )
                     ((gamestate.TimeCount == Clocks[j].time1) ||
                      (gamestate.TimeCount == Clocks[j].time2)))
                 TRIGGER[Clocks[j].linkindex]=1;
+        ptime = PROF_Mark(prof_clocks, ptime);
         for (ob = firstactive; ob;)
         {
             temp = ob->nextactive;
             DoActor (ob);
             ob = temp;
         }
+        ptime = PROF_Mark(prof_actors, ptime);
 
         BattleStatus = BATTLE_CheckGameStatus( battle_refresh, 0 );
+        PROF_Mark(prof_battle, ptime);
         if ( BattleStatus != battle_no_event )
         {
             switch( BattleStatus )
@@ -1745,6 +1837,7 @@ void UpdateGameObjects ( void )
 #if (SYNCCHECK == 1)
         CheckForSyncCheck();
 #endif
+        UpdateStateHash();
         if (timelimitenabled == true)
         {
             if (timelimit-gamestate.TimeCount>maxtimelimit)
@@ -1764,21 +1857,17 @@ void UpdateGameObjects ( void )
         if (GamePaused==true)
             break;
     }
-    actortime=GetFastTics()-atime;
+    actortime=(int)(GetFastTics()-atime);
+    SD_FlushUpdates ();
+    if (numtics > 0)
+    {
+        PROF_Mark(prof_tic, atime);
+        PROF_CountTics(numtics);
+    }
 
     UpdateClientControls ();
 
-    if (noecho == false)
-    {
-        if ( player->flags & FL_SHROOMS )
-        {
-            FX_SetReverb( 230 );
-        }
-        else if (sky == 0)
-        {
-            FX_SetReverb( min( numareatiles[ player->areanumber ] >> 1, 90 ) );
-        }
-    }
+    SD_UpdateListener ();
 }
 
 extern boolean doRescaling;
@@ -1834,7 +1923,7 @@ void PlayLoop
 )
 
 {
-    volatile int atime;
+    volatile unsigned atime;
 
     boolean canquit = true;
     int     quittime = 0;
@@ -1920,7 +2009,8 @@ fromloadedgame:
 
         SyncToServer();
 
-        drawtime = GetFastTics() - atime;
+        drawtime = (int)(GetFastTics() - atime);
+        PROF_Mark(prof_draw, atime);
 
         // Don't allow player to quit if entering message
         canquit = !MSG.messageon;
@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "rt_def.h"
+#include <stdlib.h>
 #include <string.h>
 #include "sprites.h"
 #include "rt_map.h"
@@ -58,6 +59,34 @@ static int oldw,oldh;
 static byte * skytile;
 static int mapcolor=8;
 
+//
+// The tile layer of each zoomed scale is kept between frames, only tiles
+// whose image changed are drawn again and the actors go on top.
+//
+
+#define MAPVIEWWIDTH     320
+#define MAPVIEWHEIGHT    200
+#define MAXMAPVIEWTILES  ((MAPVIEWWIDTH/4)*(MAPVIEWHEIGHT/4))
+
+#define MAPIMAGE_INVALID      -1
+#define MAPIMAGE_EMPTY        0
+#define MAPIMAGE_WALL         0x10000
+#define MAPIMAGE_SHAPE        0x20000
+#define MAPIMAGE_TRANSLUCENT  0x40000
+#define MAPIMAGE_SKY          0x80000
+#define MAPIMAGE_LUMP         0xffff
+
+typedef struct
+{
+    int   originx;
+    int   originy;
+    int   color;
+    int   image[MAXMAPVIEWTILES];
+    byte  pixels[MAPVIEWWIDTH*MAPVIEWHEIGHT];
+} maplayer_t;
+
+static maplayer_t maplayers[FULLMAP_SCALE];
+
 typedef struct PType {
     int   x;
     int   y;
@@ -165,19 +194,6 @@ void DrawMap_Wall (int x, int y, int tile)
     }
 }
 
-/*
-=======================
-=
-= DrawMap_AnimatedWall
-=
-=======================
-*/
-
-void DrawMap_AnimatedWall (int x, int y, int tile)
-{
-    DrawMap_Wall(x,y,animwalls[tile].texture);
-}
-
 /*
 =======================
 =
@@ -212,63 +228,63 @@ void DrawMap_SkyTile (int x, int y)
 /*
 =======================
 =
-= DrawMap_MaskedWall
+= MapImage_MaskedWall
 =
 =======================
 */
 
-void DrawMap_MaskedWall (int x, int y, int tile)
+int MapImage_MaskedWall (int tile)
 {
     if (IsPlatform(maskobjlist[tile]->tilex,maskobjlist[tile]->tiley))
     {
         if (!(maskobjlist[tile]->flags&MW_ABOVEPASSABLE))
-            DrawMap_MaskedShape(x,y,maskobjlist[tile]->toptexture,0);
+            return MAPIMAGE_SHAPE|maskobjlist[tile]->toptexture;
         else if (!(maskobjlist[tile]->flags&MW_BOTTOMPASSABLE))
-            DrawMap_MaskedShape(x,y,maskobjlist[tile]->bottomtexture,1);
+            return MAPIMAGE_SHAPE|MAPIMAGE_TRANSLUCENT|maskobjlist[tile]->bottomtexture;
         else
-            DrawMap_MaskedShape(x,y,maskobjlist[tile]->midtexture,0);
+            return MAPIMAGE_SHAPE|maskobjlist[tile]->midtexture;
     }
     else
     {
-        DrawMap_MaskedShape(x,y,maskobjlist[tile]->bottomtexture,1);
+        return MAPIMAGE_SHAPE|MAPIMAGE_TRANSLUCENT|maskobjlist[tile]->bottomtexture;
     }
 }
 
 /*
 =======================
 =
-= DrawMap_Door
+= MapImage_Door
 =
 =======================
 */
 
-void DrawMap_Door (int x, int y, int tile)
+int MapImage_Door (int tile)
 {
     if (
         (doorobjlist[tile]->lock > 0) &&
         (doorobjlist[tile]->lock <= 4)
     )
-        DrawMap_Wall(x,y,W_GetNumForName("lock1")+doorobjlist[tile]->lock-1);
+        return MAPIMAGE_WALL|(W_GetNumForName("lock1")+doorobjlist[tile]->lock-1);
     else if (doorobjlist[tile]->texture==doorobjlist[tile]->basetexture)
-        DrawMap_Wall(x,y,doorobjlist[tile]->texture);
+        return MAPIMAGE_WALL|doorobjlist[tile]->texture;
     else
-        DrawMap_MaskedShape(x,y,doorobjlist[tile]->texture,0);
+        return MAPIMAGE_SHAPE|doorobjlist[tile]->texture;
 }
 
 /*
 =======================
 =
-= DrawMap_PushWall
+= MapImage_PushWall
 =
 =======================
 */
 
-void DrawMap_PushWall (int x, int y, pwallobj_t * pw)
+int MapImage_PushWall (pwallobj_t * pw)
 {
     if (pw->texture&0x1000)
-        DrawMap_AnimatedWall(x,y,pw->texture&0x3ff);
+        return MAPIMAGE_WALL|animwalls[pw->texture&0x3ff].texture;
     else
-        DrawMap_Wall(x,y,pw->texture&0x3ff);
+        return MAPIMAGE_WALL|(pw->texture&0x3ff);
 }
 
 /*
@@ -397,6 +413,178 @@ void DrawMap_Player (int x, int y)
     DrawMap_MaskedShape(x,y,player->shapenum+shapestart,0);
 }
 
+/*
+=======================
+=
+= MapTileImage
+=
+= What the tile layer shows at a map tile, the player's tile is left
+= empty as the player is drawn over it
+=
+=======================
+*/
+
+int MapTileImage (int mapx, int mapy)
+{
+    objtype * a;
+    int wall;
+
+    if ((mapx==player->tilex ) && (mapy==player->tiley))
+        return MAPIMAGE_EMPTY;
+
+    wall=tilemap[mapx][mapy];
+
+    // Check for absence of wall
+
+    if (wall)
+    {
+
+        if (!mapseen[mapx][mapy])
+            return MAPIMAGE_EMPTY;
+
+        // Check to see if it is a door or masked wall
+
+        if (wall&0x8000)
+        {
+            if (wall&0x4000)
+            {
+                // Must be a masked wall
+                return MapImage_MaskedWall(wall&0x3ff);
+            }
+            else
+            {
+                // Must be a door
+                return MapImage_Door(wall&0x3ff);
+            }
+        }
+
+        // Check to see if it is an animating wall
+
+        else if (wall&0x1000)
+        {
+            return MAPIMAGE_WALL|animwalls[wall&0x3ff].texture;
+        }
+        else if (IsWindow(mapx,mapy))
+        {
+            if (sky==0)
+                Error("Trying to draw a sky on a level without sky\n");
+            return MAPIMAGE_SKY;
+        }
+        else
+        {
+            // Must be a normal wall or a wall with something above
+            return MAPIMAGE_WALL|(wall&0x3ff);
+        }
+    }
+
+    a=actorat[mapx][mapy];
+    if (a && (a->which==PWALL) && mapseen[mapx][mapy])
+        return MapImage_PushWall((pwallobj_t *)a);
+
+    return MAPIMAGE_EMPTY;
+}
+
+/*
+=======================
+=
+= DrawMapTile
+=
+= Draws one tile of the tile layer over the background colour
+=
+=======================
+*/
+
+void DrawMapTile (int i, int j, int image, byte color)
+{
+    byte * buf;
+    int y;
+
+    buf=(byte *)bufferofs+ylookup[j*tilesize]+(i*tilesize);
+    for (y=0; y<tilesize; y++,buf+=linewidth)
+        memset(buf,color,tilesize);
+
+    if (image&MAPIMAGE_SKY)
+        DrawMap_SkyTile(i,j);
+    else if (image&MAPIMAGE_WALL)
+        DrawMap_Wall(i,j,image&MAPIMAGE_LUMP);
+    else if (image&MAPIMAGE_SHAPE)
+        DrawMap_MaskedShape(i,j,image&MAPIMAGE_LUMP,(image&MAPIMAGE_TRANSLUCENT)!=0);
+}
+
+/*
+=======================
+=
+= ScrollMapLayer
+=
+= Moves what is still on screen after the view moved by dx,dy tiles and
+= marks the tiles that came into view for drawing
+=
+=======================
+*/
+
+static void ScrollMapLayer (maplayer_t * layer, int dx, int dy)
+{
+    int i,j;
+    int si,sj;
+    int row,rows;
+    int width;
+    int src,dest;
+    int step;
+
+    if ((abs(dx)>=xscale) || (abs(dy)>=yscale))
+    {
+        for (i=0; i<xscale*yscale; i++)
+            layer->image[i]=MAPIMAGE_INVALID;
+        return;
+    }
+
+    // Shift the images, walking away from the side they move towards
+
+    step=((dy>0) || ((dy==0) && (dx>0))) ? 1 : -1;
+    for (j=(step>0) ? 0 : yscale-1; (j>=0) && (j<yscale); j+=step)
+        for (i=(step>0) ? 0 : xscale-1; (i>=0) && (i<xscale); i+=step)
+        {
+            si=i+dx;
+            sj=j+dy;
+            if ((si<0) || (si>=xscale) || (sj<0) || (sj>=yscale))
+                layer->image[(j*xscale)+i]=MAPIMAGE_INVALID;
+            else
+                layer->image[(j*xscale)+i]=layer->image[(sj*xscale)+si];
+        }
+
+    // Shift the pixels of the rows that stay in view
+
+    rows=(yscale-abs(dy))*tilesize;
+    width=(xscale-abs(dx))*tilesize;
+    src=(dx>0) ? dx*tilesize : 0;
+    dest=(dx<0) ? -dx*tilesize : 0;
+    for (row=0; row<rows; row++)
+    {
+        j=(dy>0) ? row : rows-1-row;
+        memmove(&layer->pixels[((j+((dy<0) ? -dy*tilesize : 0))*MAPVIEWWIDTH)+dest],
+                &layer->pixels[((j+((dy>0) ? dy*tilesize : 0))*MAPVIEWWIDTH)+src],
+                width);
+    }
+}
+
+/*
+=======================
+=
+= ResetMapCache
+=
+= Throws away the kept tile layers, called when a level is set up
+=
+=======================
+*/
+
+void ResetMapCache (void)
+{
+    int i;
+
+    for (i=0; i<FULLMAP_SCALE; i++)
+        maplayers[i].color=-1;
+}
+
 /*
 =======================
 =
@@ -407,21 +595,72 @@ void DrawMap_Player (int x, int y)
 
 void DrawMap( int cx, int cy )
 {
-    fixed x,y;
     statobj_t * s;
     objtype * a;
+    maplayer_t * layer;
+    byte * buf;
+    byte color;
     int i,j;
     int mapx,mapy;
-    int wall;
-
-    // Clear buffer
-
-    VL_ClearBuffer (bufferofs, egacolor[mapcolor]);
+    int image;
+    int row;
+    int x,y;
 
     x=cx>>16;
     y=cy>>16;
+    color=egacolor[mapcolor];
+    layer=&maplayers[mapscale];
 
-    // Draw Walls,Doors,maskedwalls,animatingwalls
+    if (layer->color!=color)
+    {
+        memset(layer->pixels,color,sizeof(layer->pixels));
+        for (i=0; i<xscale*yscale; i++)
+            layer->image[i]=MAPIMAGE_EMPTY;
+        layer->color=color;
+        layer->originx=x;
+        layer->originy=y;
+    }
+    else if ((x!=layer->originx) || (y!=layer->originy))
+    {
+        ScrollMapLayer(layer,x-layer->originx,y-layer->originy);
+        layer->originx=x;
+        layer->originy=y;
+    }
+
+    // Put the kept tile layer up
+
+    buf=(byte *)bufferofs;
+    for (j=0; j<MAPVIEWHEIGHT; j++,buf+=linewidth)
+        memcpy(buf,&layer->pixels[j*MAPVIEWWIDTH],MAPVIEWWIDTH);
+
+    // Draw Walls,Doors,maskedwalls,animatingwalls that changed
+
+    for (j=0; j<yscale; j++)
+    {
+        mapy=j+y;
+        for (i=0; i<xscale; i++)
+        {
+            mapx=i+x;
+
+            // Nothing is drawn off the edges of the map
+
+            if ((mapx<0) || (mapx>127) || (mapy<0) || (mapy>127))
+                image=MAPIMAGE_EMPTY;
+            else
+                image=MapTileImage(mapx,mapy);
+
+            if (image==layer->image[(j*xscale)+i])
+                continue;
+
+            DrawMapTile(i,j,image,color);
+            buf=(byte *)bufferofs+ylookup[j*tilesize]+(i*tilesize);
+            for (row=0; row<tilesize; row++,buf+=linewidth)
+                memcpy(&layer->pixels[(((j*tilesize)+row)*MAPVIEWWIDTH)+(i*tilesize)],buf,tilesize);
+            layer->image[(j*xscale)+i]=image;
+        }
+    }
+
+    // Draw the player, actors and sprites on top
 
     for (j=0; j<yscale; j++)
     {
@@ -455,87 +694,39 @@ void DrawMap( int cx, int cy )
                 continue;
             }
 
-            wall=tilemap[mapx][mapy];
-
-            // Check for absence of wall
-
-            if (wall)
-            {
-
-                if (!mapseen[mapx][mapy])
-                    continue;
-
-                // Check to see if it is a door or masked wall
+            if (tilemap[mapx][mapy])
+                continue;
 
-                if (wall&0x8000)
-                {
-                    if (wall&0x4000)
-                    {
-                        // Must be a masked wall
-                        DrawMap_MaskedWall(i,j,wall&0x3ff);
-                    }
-                    else
-                    {
-                        // Must be a door
-                        DrawMap_Door(i,j,wall&0x3ff);
-                    }
-                }
+            a=actorat[mapx][mapy];
 
-                // Check to see if it is an animating wall
+            // Check for absence of actor
 
-                else if (wall&0x1000)
-                {
-                    DrawMap_AnimatedWall(i,j,wall&0x3ff);
-                }
-                else if (IsWindow(mapx,mapy))
-                {
-                    if (sky!=0)
-                        DrawMap_SkyTile(i,j);
-                    else
-                        Error("Trying to draw a sky on a level without sky\n");
-                }
-                else
+            if (a)
+            {
+                switch(a->which)
                 {
-                    // Must be a normal wall or a wall with something above
-                    DrawMap_Wall(i,j,wall&0x3ff);
+                case PWALL:
+                    break;
+                case ACTOR:
+                    DrawMap_Actor(i,j,a);
+                    break;
+                case SPRITE:
+                    DrawMap_Actor(i,j,a);
+                    break;
+                default:
+                    SoftError("Unable to resolve actorat at x=%d y=%d which=%d\n",mapx,mapy,a->which);
+                    break;
                 }
             }
             else
             {
-                a=actorat[mapx][mapy];
+                s=sprites[mapx][mapy];
 
-                // Check for absence of actor
+                // Check for absence of sprite
 
-                if (a)
-                {
-                    switch(a->which)
-                    {
-                    case PWALL:
-                        if (!mapseen[mapx][mapy])
-                            continue;
-                        DrawMap_PushWall(i,j,(pwallobj_t *)a);
-                        break;
-                    case ACTOR:
-                        DrawMap_Actor(i,j,a);
-                        break;
-                    case SPRITE:
-                        DrawMap_Actor(i,j,a);
-                        break;
-                    default:
-                        SoftError("Unable to resolve actorat at x=%d y=%d which=%d\n",mapx,mapy,a->which);
-                        break;
-                    }
-                }
-                else
+                if (s)
                 {
-                    s=sprites[mapx][mapy];
-
-                    // Check for absence of sprite
-
-                    if (s)
-                    {
-                        DrawMap_Sprite(i,j,s);
-                    }
+                    DrawMap_Sprite(i,j,s);
                 }
             }
         }
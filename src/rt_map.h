@@ -26,5 +26,6 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 void DoMap(int x, int y);
 void CheatMap( void );
+void ResetMapCache (void);
 
 #endif
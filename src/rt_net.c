@@ -20,6 +20,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <unistd.h>
+#if PLATFORM_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "SDL2/SDL.h"
 #include "rt_def.h"
 #include "rt_main.h"
 #include "rt_net.h"
@@ -86,6 +92,17 @@ byte     *demoptr,
          *demobuffer=NULL;
 boolean  demodone = false;
 int      predemo_violence = -1;
+
+static byte        *demorecordbuffers[2];
+static int          demorecordhandle=-1;
+static SDL_Thread  *demowriter=NULL;
+static SDL_sem     *demowritesem;
+static SDL_sem     *demoidlesem;
+static byte        *demowriteptr;
+static int          demowritelength;
+static volatile boolean demowritefailed;
+static boolean      demomapped=false;
+static long         demomapsize;
 int oldmomx;
 int oldmomy;
 int oldspdang;
@@ -2896,6 +2913,98 @@ boolean DemoExists (int demonumber)
     }
 }
 
+//****************************************************************************
+//
+// DemoWriterThread ()
+//
+// Writes each filled record buffer to disk while the game keeps recording
+// into the other one.  A zero length request ends the thread.
+//
+//****************************************************************************
+
+static int DemoWriterThread (void * data)
+{
+    (void)data;
+
+    while (1)
+    {
+        SDL_SemWait (demowritesem);
+        if (demowritelength == 0)
+            break;
+        if (write (demorecordhandle, demowriteptr, demowritelength) != demowritelength)
+            demowritefailed = true;
+        SDL_SemPost (demoidlesem);
+    }
+    return 0;
+}
+
+//****************************************************************************
+//
+// QueueDemoWrite ()
+//
+// Hands the current record buffer to the writer thread and switches
+// recording over to the other buffer.
+//
+//****************************************************************************
+
+static void QueueDemoWrite ( void )
+{
+    int length;
+
+    length = demoptr-demobuffer;
+    if (length == 0)
+        return;
+
+    SDL_SemWait (demoidlesem);
+    if (demowritefailed == true)
+        Error ("Demo write failure\n");
+    demowriteptr = demobuffer;
+    demowritelength = length;
+    SDL_SemPost (demowritesem);
+
+    if (demobuffer == demorecordbuffers[0])
+        demobuffer = demorecordbuffers[1];
+    else
+        demobuffer = demorecordbuffers[0];
+    demoptr = demobuffer;
+    lastdemoptr = demobuffer+DEMOBUFFSIZE;
+}
+
+//****************************************************************************
+//
+// StopDemoWriter ()
+//
+// Flushes whatever has been recorded and closes the temporary demo file.
+//
+//****************************************************************************
+
+static void StopDemoWriter ( void )
+{
+    if (demowriter == NULL)
+        return;
+
+    QueueDemoWrite ();
+
+    SDL_SemWait (demoidlesem);
+    demowritelength = 0;
+    SDL_SemPost (demowritesem);
+    SDL_WaitThread (demowriter, NULL);
+    demowriter = NULL;
+
+    SDL_DestroySemaphore (demowritesem);
+    SDL_DestroySemaphore (demoidlesem);
+    close (demorecordhandle);
+    demorecordhandle = -1;
+
+    SafeFree (demorecordbuffers[0]);
+    SafeFree (demorecordbuffers[1]);
+    demorecordbuffers[0] = demorecordbuffers[1] = NULL;
+    demobuffer = NULL;
+
+    if (demowritefailed == true)
+        Error ("Demo write failure\n");
+}
+
 //****************************************************************************
 //
 // SaveDemo ()
@@ -2905,10 +3014,16 @@ boolean DemoExists (int demonumber)
 void SaveDemo (int demonumber)
 {
     char demo[20 + sizeof(DATADIR)];
+    char temp[20 + sizeof(DATADIR)];
 
     RecordDemoCmd ();
+    StopDemoWriter ();
     GetDemoFilename (demonumber, &demo[0]);
-    SaveFile (demo, demobuffer, (demoptr-demobuffer));
+    strcpy (temp, DEMOTEMPNAME);
+    FixFilePath (temp);
+    remove (demo);
+    if (rename (temp, demo) != 0)
+        Error ("Could not save demo %s\n", demo);
     FreeDemo();
 }
 
@@ -2921,12 +3036,35 @@ void SaveDemo (int demonumber)
 void LoadDemo (int demonumber)
 {
     char demo[20 + sizeof(DATADIR)];
-    int size;
+    long size;
 
     GetDemoFilename (demonumber, demo);
     if (demobuffer!=NULL)
         FreeDemo();
+
+#if PLATFORM_UNIX
+    {
+        int handle;
+        struct stat st;
+
+        // Map the demo instead of reading it, long recordings are only
+        // paged in as playback reaches them
+
+        handle = SafeOpenRead (demo);
+        if (fstat (handle, &st) != 0)
+            Error ("Could not stat demo %s\n", demo);
+        size = st.st_size;
+        demobuffer = mmap (NULL, size, PROT_READ, MAP_PRIVATE, handle, 0);
+        close (handle);
+        if (demobuffer == MAP_FAILED)
+            Error ("Could not map demo %s\n", demo);
+        madvise (demobuffer, size, MADV_SEQUENTIAL);
+        demomapped = true;
+        demomapsize = size;
+    }
+#else
     size = LoadFile (demo, (void **)&demobuffer);
+#endif
     playstate = ex_demoplayback;
     demoptr = demobuffer;
     lastdemoptr = (demoptr+size);
@@ -2940,25 +3078,40 @@ void LoadDemo (int demonumber)
 //
 // RecordDemo ()
 //
+// Demo commands are streamed to a temporary file through two buffers, so
+// a recording can be as long as the disk allows.  SaveDemo renames the
+// file once the player picks a demo number.
+//
 //****************************************************************************
 
 void RecordDemo ( void )
 {
-    DemoHeaderType * DemoHeader;
+    char temp[20 + sizeof(DATADIR)];
     int level;
 
     if (demobuffer!=NULL)
         FreeDemo();
     godmode=0;
-    demobuffer = SafeMalloc (DEMOBUFFSIZE);
+
+    strcpy (temp, DEMOTEMPNAME);
+    demorecordhandle = SafeOpenWrite (temp);
+    demorecordbuffers[0] = SafeMalloc (DEMOBUFFSIZE);
+    demorecordbuffers[1] = SafeMalloc (DEMOBUFFSIZE);
+    demobuffer = demorecordbuffers[0];
     demoptr = demobuffer;
     lastdemoptr = demobuffer+DEMOBUFFSIZE;
 
+    demowritefailed = false;
+    demowritesem = SDL_CreateSemaphore (0);
+    demoidlesem = SDL_CreateSemaphore (1);
+    demowriter = SDL_CreateThread (DemoWriterThread, "DemoWriter", NULL);
+    if (demowriter == NULL)
+        Error ("Could not start demo writer: %s\n", SDL_GetError());
+
     // Save off level number
 
-    DemoHeader=(DemoHeaderType *)demoptr;
+    memcpy(demoptr,&gamestate,sizeof(gamestate));
     demoptr+=sizeof(gamestate);
-    memcpy(&(DemoHeader->demostate),&gamestate,sizeof(gamestate));
     demorecord = true;
     locplayerstate->player=0;
     InitializeWeapons(locplayerstate);
@@ -2998,9 +3151,30 @@ void SetupDemo ( void )
 
 void FreeDemo ( void )
 {
+    char temp[20 + sizeof(DATADIR)];
+
     demoplayback = false;
     demorecord = false;
-    SafeFree (demobuffer);
+    if (demowriter != NULL)
+    {
+        // Recording was abandoned without being saved
+
+        StopDemoWriter ();
+        strcpy (temp, DEMOTEMPNAME);
+        FixFilePath (temp);
+        remove (temp);
+    }
+#if PLATFORM_UNIX
+    else if (demomapped == true)
+    {
+        munmap (demobuffer, demomapsize);
+        demomapped = false;
+    }
+#endif
+    else if (demobuffer != NULL)
+    {
+        SafeFree (demobuffer);
+    }
     demobuffer=NULL;
 }
 
@@ -3019,21 +3193,6 @@ void CheckForDemoDone ( void )
     }
 }
 
-//****************************************************************************
-//
-// CheckForDemoOverflowed ()
-//
-//****************************************************************************
-
-void CheckForDemoOverflowed ( void )
-{
-    if (demoptr >= (lastdemoptr-sizeof(DemoType)))
-    {
-        playstate = ex_completed;     // demo is done
-        EndDemo();
-    }
-}
-
 //****************************************************************************
 //
 // RecordDemoCmd ()
@@ -3054,7 +3213,8 @@ void RecordDemoCmd (void)
 
     demoptr+=sizeof(DemoType);
 
-    CheckForDemoOverflowed();
+    if (demoptr > (lastdemoptr-sizeof(DemoType)))
+        QueueDemoWrite();
 }
 
 //****************************************************************************
@@ -0,0 +1,257 @@
+/*
+Copyright (C) 1994-1995  Apogee Software, Ltd.
+Copyright (C) 2002-2015  icculus.org, GNU/Linux port
+Copyright (C) 2017-2018  Steven LeVesque
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "rt_def.h"
+#include "rt_prof.h"
+#include "isr.h"
+#include "rt_menu.h"
+#include "rt_str.h"
+#include "rt_util.h"
+#include "modexlib.h"
+#include "music.h"
+#include "fx_man.h"
+
+
+//****************************************************************************
+//
+// GLOBALS
+//
+//****************************************************************************
+
+#define PROFBUCKETS   16      // power of two microsecond buckets
+#define MAXCATCHUP    16      // tics per UpdateGameObjects call
+
+typedef struct
+{
+    unsigned            count;
+    unsigned long long  total;
+    unsigned            last;
+    unsigned            max;
+    unsigned            histogram[PROFBUCKETS];
+} profstat_t;
+
+boolean telemetry = false;
+
+static profstat_t profstats[NUMPROFSECTIONS];
+static unsigned   catchup[MAXCATCHUP+1];
+
+static const char *profnames[NUMPROFSECTIONS] =
+{
+    "DOORS",
+    "ELEVATORS",
+    "PUSHWALLS",
+    "LIGHTNING",
+    "TRIGGERS",
+    "STATICS",
+    "RESURRECT",
+    "CLOCKS",
+    "ACTORS",
+    "BATTLE",
+    "TIC",
+    "DRAW"
+};
+
+
+//****************************************************************************
+//
+// PROF_Startup ()
+//
+//****************************************************************************
+
+void PROF_Startup ( void )
+{
+    memset (profstats, 0, sizeof(profstats));
+    memset (catchup, 0, sizeof(catchup));
+    telemetry = true;
+}
+
+//****************************************************************************
+//
+// PROF_Time ()
+//
+// Returns the time to pass to the first PROF_Mark of a run of sections
+//
+//****************************************************************************
+
+unsigned PROF_Time ( void )
+{
+    if (telemetry == false)
+        return 0;
+
+    return GetFastTics();
+}
+
+//****************************************************************************
+//
+// PROF_Mark ()
+//
+// Charges the time since start to section and returns the current time,
+// so consecutive sections can be chained:
+//
+//    t = PROF_Time ();
+//    MoveDoors ();
+//    t = PROF_Mark (prof_doors, t);
+//
+//****************************************************************************
+
+unsigned PROF_Mark ( profsection_t section, unsigned start )
+{
+    profstat_t *stat;
+    unsigned now;
+    unsigned elapsed;
+    int bucket;
+
+    if (telemetry == false)
+        return 0;
+
+    now = GetFastTics();
+    elapsed = now - start;
+
+    stat = &profstats[section];
+    stat->count++;
+    stat->total += elapsed;
+    stat->last = elapsed;
+    if (elapsed > stat->max)
+        stat->max = elapsed;
+
+    for (bucket = 0; (bucket < PROFBUCKETS-1) && (elapsed >> bucket); bucket++)
+        ;
+    stat->histogram[bucket]++;
+
+    return now;
+}
+
+//****************************************************************************
+//
+// PROF_CountTics ()
+//
+// Records how many tics one UpdateGameObjects call had to catch up on
+//
+//****************************************************************************
+
+void PROF_CountTics ( int numtics )
+{
+    if (telemetry == false)
+        return;
+
+    catchup[min(numtics, MAXCATCHUP)]++;
+}
+
+//****************************************************************************
+//
+// PROF_Draw ()
+//
+// Shows last, average and worst time in microseconds for each section
+//
+//****************************************************************************
+
+#define PROFX  4
+#define PROFY  16
+#define PROFW  100
+
+void PROF_Draw ( void )
+{
+    int i;
+    unsigned avg;
+    char buf[40];
+
+    if (telemetry == false)
+        return;
+
+    CurrentFont = tinyfont;
+
+    for (i = 0; i < (NUMPROFSECTIONS*6); i++)
+        memset ((byte *)bufferofs+ylookup[i+PROFY]+PROFX, 0, PROFW);
+
+    for (i = 0; i < NUMPROFSECTIONS; i++)
+    {
+        if (profstats[i].count)
+            avg = (unsigned)(profstats[i].total / profstats[i].count);
+        else
+            avg = 0;
+
+        snprintf (buf, sizeof(buf), "%s %u %u %u", profnames[i],
+                  profstats[i].last, avg, profstats[i].max);
+        px = PROFX;
+        py = PROFY + (i*6);
+        VW_DrawPropString (buf);
+    }
+}
+
+//****************************************************************************
+//
+// PROF_Dump ()
+//
+//****************************************************************************
+
+void PROF_Dump ( void )
+{
+    int i, j;
+    profstat_t *stat;
+    unsigned long underruns;
+    unsigned long underrunbytes;
+    int switchtime;
+    int maxswitchtime;
+    unsigned long mixframes;
+    unsigned long mixtime;
+
+    if (telemetry == false)
+        return;
+
+    printf ("\nTic telemetry (microseconds)\n");
+    printf ("%-10s %10s %8s %8s\n", "SECTION", "COUNT", "AVG", "MAX");
+    for (i = 0; i < NUMPROFSECTIONS; i++)
+    {
+        stat = &profstats[i];
+        printf ("%-10s %10u %8u %8u\n", profnames[i], stat->count,
+                stat->count ? (unsigned)(stat->total / stat->count) : 0, stat->max);
+    }
+
+    printf ("\nHistogram (count of samples under each time)\n");
+    printf ("%-10s", "SECTION");
+    for (j = 0; j < PROFBUCKETS-1; j++)
+        printf (" %7d", 1 << j);
+    printf (" %6d+\n", 1 << (PROFBUCKETS-2));
+    for (i = 0; i < NUMPROFSECTIONS; i++)
+    {
+        printf ("%-10s", profnames[i]);
+        for (j = 0; j < PROFBUCKETS; j++)
+            printf (" %7u", profstats[i].histogram[j]);
+        printf ("\n");
+    }
+
+    printf ("\nTics run per update\n");
+    for (i = 0; i <= MAXCATCHUP; i++)
+    {
+        if (catchup[i])
+            printf ("%2d%s %10u\n", i, (i == MAXCATCHUP) ? "+" : " ", catchup[i]);
+    }
+
+    underruns = MUSIC_GetUnderruns (&underrunbytes);
+    printf ("\nMusic underruns %lu (%lu bytes of silence)\n", underruns, underrunbytes);
+    switchtime = MUSIC_GetSwitchTime (&maxswitchtime);
+    printf ("Music switch %d ms, worst %d ms\n", switchtime, maxswitchtime);
+
+    FX_GetMixStats (&mixframes, &mixtime);
+    if (mixframes > 0)
+        printf ("Audio mix %lu frames in %lu us, %lu us per 1024 frames\n",
+                mixframes, mixtime, (unsigned long)((double)mixtime * 1024 / mixframes));
+
+    telemetry = false;
+}
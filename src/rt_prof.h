@@ -0,0 +1,55 @@
+/*
+Copyright (C) 1994-1995  Apogee Software, Ltd.
+Copyright (C) 2002-2015  icculus.org, GNU/Linux port
+Copyright (C) 2017-2018  Steven LeVesque
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+//***************************************************************************
+//
+//   RT_PROF.H - Per-tic subsystem timing
+//
+//***************************************************************************
+
+#ifndef _rt_prof_public
+#define _rt_prof_public
+
+#include "rt_def.h"
+
+typedef enum
+{
+    prof_doors,
+    prof_elevators,
+    prof_pushwalls,
+    prof_lightning,
+    prof_triggers,
+    prof_statics,
+    prof_resurrect,
+    prof_clocks,
+    prof_actors,
+    prof_battle,
+    prof_tic,
+    prof_draw,
+    NUMPROFSECTIONS
+} profsection_t;
+
+extern boolean telemetry;
+
+void PROF_Startup ( void );
+unsigned PROF_Time ( void );
+unsigned PROF_Mark ( profsection_t section, unsigned start );
+void PROF_CountTics ( int numtics );
+void PROF_Draw ( void );
+void PROF_Dump ( void );
+
+#endif
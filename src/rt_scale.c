@@ -56,6 +56,34 @@ byte * dc_source;
 int centeryclipped;
 int transparentlevel=0;
 
+//
+// Sprite span cache.  The first time a sprite lump is drawn its posts are
+// decoded into a table of spans per column, so the column loops only
+// scale and draw.  Sources are kept as offsets into the lump since the
+// lump itself is purgable and may come back at another address.  The
+// tables are purgable as well; the zone clears their entry in
+// spritespans when it reclaims one and the next draw decodes it again.
+//
+
+#define SPAN_TRANSLUCENT 0x01   // see-through post, source is unused
+
+typedef struct
+{
+    byte  offset;               // first texel row
+    byte  length;
+    byte  flags;                // SPAN_ flags
+    int   source;               // dc_source offset from the lump start
+} spritespan_t;
+
+typedef struct
+{
+    int            width;
+    int          * columns;     // first span of each column, [width] ends
+    spritespan_t * spans;
+} spritespans_t;
+
+static spritespans_t ** spritespans[2];    // patch and transpatch decodes
+
 /*
 ==========================
 =
@@ -97,7 +125,7 @@ void SetPlayerLightLevel (void)
 
     if (lightsource)
     {
-        lv=(((LightSourceAt(player->x>>16,player->y>>16)>>intercept)&0xf)>>1);
+        lv=LightLevelAt(player->x>>16,player->y>>16,intercept);
         i=maxshade-(height>>normalshade)-lv;
         if (i<minshade) i=minshade;
         shadingtable=colormap+(i<<8);
@@ -138,7 +166,7 @@ void SetLightLevel (int height)
     }
     if (fog)
     {
-        i=((height*200/iGLOBAL_SCREENHEIGHT)>>normalshade)+minshade;
+        i=((height*200/renderheight)>>normalshade)+minshade;
         if (i>maxshade) i=maxshade;
         shadingtable=colormap+(i<<8);
     }
@@ -150,6 +178,237 @@ void SetLightLevel (int height)
     }
 }
 
+/*
+==========================
+=
+= DecodeSpritePosts
+=
+= Walks the posts of every column, filling the span table when spans is
+= not NULL, and returns the number of spans
+=
+==========================
+*/
+
+static int DecodeSpritePosts (byte * shape, int width, unsigned short * collumnofs,
+                              boolean trans, int * columns, spritespan_t * spans)
+{
+    int  x;
+    int  n;
+    int  offset;
+    int  length;
+    byte * src;
+
+    n=0;
+    for (x=0; x<width; x++)
+    {
+        if (columns)
+            columns[x]=n;
+        src=shape+collumnofs[x];
+        offset=*(src++);
+        for (; offset!=255;)
+        {
+            length=*(src++);
+            if (spans)
+            {
+                spans[n].offset=offset;
+                spans[n].length=length;
+                spans[n].flags=0;
+                spans[n].source=0;
+            }
+            if ((trans==true) && ((*src)==254))
+            {
+                if (spans)
+                    spans[n].flags=SPAN_TRANSLUCENT;
+                src++;
+            }
+            else
+            {
+                if (spans)
+                    spans[n].source=(src-shape)-offset;
+                src+=length;
+            }
+            offset=*(src++);
+            n++;
+        }
+    }
+    if (columns)
+        columns[width]=n;
+
+    return n;
+}
+
+/*
+==========================
+=
+= GetSpriteSpans
+=
+= Returns the decoded spans of a sprite lump already cached in shape.
+= The table stays valid until the next zone allocation.
+=
+==========================
+*/
+
+static spritespans_t * GetSpriteSpans (int lump, byte * shape, boolean trans)
+{
+    spritespans_t * s;
+    int width;
+    int numspans;
+    unsigned short * collumnofs;
+
+    if (spritespans[trans]==NULL)
+    {
+        spritespans[trans]=SafeMalloc(numlumps*sizeof(spritespans_t *));
+        memset(spritespans[trans],0,numlumps*sizeof(spritespans_t *));
+    }
+
+    s=spritespans[trans][lump];
+    if (s!=NULL)
+        return s;
+
+    if (trans==true)
+    {
+        width=((transpatch_t *)shape)->width;
+        collumnofs=(unsigned short *)((transpatch_t *)shape)->collumnofs;
+    }
+    else
+    {
+        width=((patch_t *)shape)->width;
+        collumnofs=((patch_t *)shape)->collumnofs;
+    }
+
+    numspans=DecodeSpritePosts(shape,width,collumnofs,trans,NULL,NULL);
+
+    // keep the zone from purging the lump to make room for its spans
+    Z_ChangeTag(shape,PU_STATIC);
+    s=Z_Malloc(sizeof(spritespans_t)+((width+1)*sizeof(int))+
+               (numspans*sizeof(spritespan_t)),PU_CACHE,&spritespans[trans][lump]);
+    Z_ChangeTag(shape,PU_CACHE);
+
+    s->width=width;
+    s->spans=(spritespan_t *)(s+1);
+    s->columns=(int *)(s->spans+numspans);
+    DecodeSpritePosts(shape,width,collumnofs,trans,s->columns,s->spans);
+
+    return s;
+}
+
+/*
+==========================
+=
+= ScaleMaskedSpans
+=
+= The ScaleMaskedPost, ScaleTransparentPost and ScaleSolidMaskedPost
+= loops run over decoded spans
+=
+==========================
+*/
+
+static void ScaleMaskedSpans (byte * shape, spritespans_t * s, int column, byte * buf)
+{
+    spritespan_t * span;
+    spritespan_t * last;
+    int  topscreen;
+    int  bottomscreen;
+
+    span=&s->spans[s->columns[column]];
+    last=&s->spans[s->columns[column+1]];
+    for (; span<last; span++)
+    {
+        topscreen = sprtopoffset + (dc_invscale*span->offset);
+        bottomscreen = topscreen + (dc_invscale*span->length);
+        dc_yl = (topscreen+SFRACUNIT)>>SFRACBITS;
+        dc_yh = ((bottomscreen-1)>>SFRACBITS);
+        if (dc_yh >= viewheight)
+            dc_yh = viewheight-1;
+        if (dc_yl < 0)
+            dc_yl = 0;
+        if (dc_yl <= dc_yh)
+        {
+            dc_source=shape+span->source;
+            R_DrawColumn (buf);
+        }
+    }
+}
+
+static void ScaleMaskedWideSpans (byte * shape, spritespans_t * s, int column,
+                                  byte * buf, int x, int width)
+{
+    buf += x;
+
+    while (width--) {
+        ScaleMaskedSpans(shape,s,column,buf);
+        buf++;
+    }
+}
+
+static void ScaleTransparentSpans (byte * shape, spritespans_t * s, int column,
+                                   byte * buf, int level)
+{
+    spritespan_t * span;
+    spritespan_t * last;
+    int  topscreen;
+    int  bottomscreen;
+    byte * oldlevel;
+    byte * seelevel;
+
+    seelevel=colormap+(((level+64)>>2)<<8);
+    oldlevel=shadingtable;
+    span=&s->spans[s->columns[column]];
+    last=&s->spans[s->columns[column+1]];
+    for (; span<last; span++)
+    {
+        topscreen = sprtopoffset + (dc_invscale*span->offset);
+        bottomscreen = topscreen + (dc_invscale*span->length);
+        dc_yl = (topscreen+SFRACUNIT)>>SFRACBITS;
+        dc_yh = ((bottomscreen-1)>>SFRACBITS);
+        if (dc_yh >= viewheight)
+            dc_yh = viewheight-1;
+        if (dc_yl < 0)
+            dc_yl = 0;
+        if (dc_yl > dc_yh)
+            continue;
+        if (span->flags & SPAN_TRANSLUCENT)
+        {
+            shadingtable=seelevel;
+            R_TransColumn (buf);
+            shadingtable=oldlevel;
+        }
+        else
+        {
+            dc_source=shape+span->source;
+            R_DrawColumn (buf);
+        }
+    }
+}
+
+static void ScaleSolidMaskedSpans (int color, byte * shape, spritespans_t * s,
+                                   int column, byte * buf)
+{
+    spritespan_t * span;
+    spritespan_t * last;
+    int  topscreen;
+    int  bottomscreen;
+
+    span=&s->spans[s->columns[column]];
+    last=&s->spans[s->columns[column+1]];
+    for (; span<last; span++)
+    {
+        topscreen = sprtopoffset + (dc_invscale*span->offset);
+        bottomscreen = topscreen + (dc_invscale*span->length);
+        dc_yl = (topscreen+SFRACUNIT)>>SFRACBITS;
+        dc_yh = ((bottomscreen-1)>>SFRACBITS);
+        if (dc_yh >= viewheight)
+            dc_yh = viewheight-1;
+        if (dc_yl < 0)
+            dc_yl = 0;
+        if (dc_yl <= dc_yh)
+        {
+            dc_source=shape+span->source;
+            R_DrawSolidColumn (color, buf);
+        }
+    }
+}
+
 /*
 ==========================
 =
@@ -382,6 +641,7 @@ void ScaleShape (visobj_t * sprite)
     byte *shape;
     int      frac;
     patch_t *p;
+    spritespans_t *spans;
     int      x1,x2;
     int      tx;
     int      size;
@@ -389,6 +649,7 @@ void ScaleShape (visobj_t * sprite)
     whereami=32;
     shape=W_CacheLumpNum(sprite->shapenum,PU_CACHE, Cvt_patch_t, 1);
     p=(patch_t *)shape;
+    spans=GetSpriteSpans(sprite->shapenum,shape,false);
     size=p->origsize>>7;
 //   sprite->viewheight<<=1;
     dc_invscale=sprite->viewheight<<((10-HEIGHTFRACTION)-size);
@@ -440,7 +701,7 @@ void ScaleShape (visobj_t * sprite)
             {
                 if (lastcolumn>=0)
                 {
-                    ScaleMaskedWidePost(((p->collumnofs[lastcolumn])+shape),(byte *)bufferofs,startx,width);
+                    ScaleMaskedWideSpans(shape,spans,lastcolumn,(byte *)bufferofs,startx,width);
                     width=1;
                     lastcolumn=-1;
                 }
@@ -456,7 +717,7 @@ void ScaleShape (visobj_t * sprite)
             {
                 if (lastcolumn>=0)
                 {
-                    ScaleMaskedWidePost(((p->collumnofs[lastcolumn])+shape),(byte *)bufferofs,startx,width);
+                    ScaleMaskedWideSpans(shape,spans,lastcolumn,(byte *)bufferofs,startx,width);
                     width=1;
                     startx=x1;
                     lastcolumn=texturecolumn;
@@ -469,7 +730,7 @@ void ScaleShape (visobj_t * sprite)
             }
         }
         if (lastcolumn!=-1)
-            ScaleMaskedWidePost(((p->collumnofs[lastcolumn])+shape),(byte *)bufferofs,startx,width);
+            ScaleMaskedWideSpans(shape,spans,lastcolumn,(byte *)bufferofs,startx,width);
     }
     else
     {
@@ -491,9 +752,9 @@ void ScaleShape (visobj_t * sprite)
                     )
                         continue;
                     if (x1==viewwidth-1)
-                        ScaleMaskedWidePost(((p->collumnofs[frac>>SFRACBITS])+shape),(byte *)bufferofs,x1,1);
+                        ScaleMaskedWideSpans(shape,spans,frac>>SFRACBITS,(byte *)bufferofs,x1,1);
                     else
-                        ScaleMaskedWidePost(((p->collumnofs[frac>>SFRACBITS])+shape),(byte *)bufferofs,x1,2);
+                        ScaleMaskedWideSpans(shape,spans,frac>>SFRACBITS,(byte *)bufferofs,x1,2);
                 }
             }
         }
@@ -508,7 +769,7 @@ void ScaleShape (visobj_t * sprite)
                 {
                     if (posts[x1].wallheight>sprite->viewheight)
                         continue;
-                    ScaleMaskedPost(((p->collumnofs[frac>>SFRACBITS])+shape),b);
+                    ScaleMaskedSpans(shape,spans,frac>>SFRACBITS,b);
                 }
             }
         }
@@ -529,6 +790,7 @@ void ScaleTransparentShape (visobj_t * sprite)
     byte *shape;
     int      frac;
     transpatch_t *p;
+    spritespans_t *spans;
     int      x1,x2;
     int      tx;
     int      size;
@@ -539,6 +801,7 @@ void ScaleTransparentShape (visobj_t * sprite)
     whereami=33;
     shape=W_CacheLumpNum(sprite->shapenum,PU_CACHE, Cvt_transpatch_t, 1);
     p=(transpatch_t *)shape;
+    spans=GetSpriteSpans(sprite->shapenum,shape,true);
     size=p->origsize>>7;
     dc_invscale=sprite->viewheight<<((10-HEIGHTFRACTION)-size);
     tx=-p->leftoffset;
@@ -584,7 +847,7 @@ void ScaleTransparentShape (visobj_t * sprite)
         {
             if (posts[x1].wallheight>sprite->viewheight)
                 continue;
-            ScaleTransparentPost(((p->collumnofs[frac>>SFRACBITS])+shape),b,sprite->h2);
+            ScaleTransparentSpans(shape,spans,frac>>SFRACBITS,b,sprite->h2);
         }
     }
 }
@@ -602,6 +865,7 @@ void ScaleSolidShape (visobj_t * sprite)
     byte *shape;
     int      frac;
     patch_t *p;
+    spritespans_t *spans;
     int      x1,x2;
     int      tx;
     int      size;
@@ -612,6 +876,7 @@ void ScaleSolidShape (visobj_t * sprite)
     whereami=34;
     shape=W_CacheLumpNum(sprite->shapenum,PU_CACHE, Cvt_patch_t, 1);
     p=(patch_t *)shape;
+    spans=GetSpriteSpans(sprite->shapenum,shape,false);
     size=p->origsize>>7;
     dc_invscale=sprite->viewheight<<((10-HEIGHTFRACTION)-size);
     tx=-p->leftoffset;
@@ -658,7 +923,7 @@ void ScaleSolidShape (visobj_t * sprite)
         {
             if (posts[x1].wallheight>sprite->viewheight)
                 continue;
-            ScaleSolidMaskedPost(sprite->h2,((p->collumnofs[frac>>SFRACBITS])+shape),b);
+            ScaleSolidMaskedSpans(sprite->h2,shape,spans,frac>>SFRACBITS,b);
         }
     }
 }
@@ -39,6 +39,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "rt_net.h"
 
 #include "rt_str.h"
+#include "rt_door.h"
+#include "rt_floor.h"
 
 #if (SHAREWARE==0)
 #include "snd_reg.h"
@@ -56,6 +58,17 @@ static int NumBadSounds=0;
 static int remotestart;
 static boolean SoundsRemapped = false;
 
+// Sound zones, the reverb of each area is fixed at level setup and the
+// areas the listener can hear directly follow areaconnect
+
+static byte    areareverb[NUMAREAS+1];
+static boolean listenerareas[NUMAREAS];
+static int     listenerarea = -1;
+static boolean areaschanged = true;
+static int     currentreverb = -1;
+
+static void SD_OccludeSound ( int handle, int x, int y );
+
 int musicnums[ 11 ] = {
     -1, -1, -1, -1, -1, -1, SoundScape, -1, -1, -1, -1
 };
@@ -430,6 +443,8 @@ int SD_PlayPositionedSound ( int sndnum, int px, int py, int x, int y )
     }
 
     voice = SD_PlayIt ( sndnum, angle, distance, pitch );
+    if (voice > 0)
+        SD_OccludeSound ( voice, x, y );
 
     return voice;
 
@@ -479,6 +494,8 @@ int SD_PlaySoundRTP ( int sndnum, int x, int y )
     }
 
     voice = SD_PlayIt ( sndnum, angle, distance, pitch );
+    if (voice > 0)
+        SD_OccludeSound ( voice, x, y );
 
     return voice;
 }
@@ -516,10 +533,10 @@ void SD_SetSoundPitch ( int sndnum, int pitch )
     if (SD_Started==false)
         return;
 
-    FX_SetPitch( sndnum, pitch );
-    
     if (!FX_SoundActive(sndnum))
         return;
+
+    FX_SetPitch( sndnum, pitch );
 }
 
 //***************************************************************************
@@ -558,6 +575,9 @@ void SD_PanRTP ( int handle, int x, int y )
     {
         angle = 0;
     }
+
+    FX_Pan3D ( handle, angle, distance );
+    SD_OccludeSound ( handle, x, y );
 }
 
 //***************************************************************************
@@ -575,6 +595,8 @@ void SD_SetPan ( int handle, int vol, int left, int right )
 
     if (!FX_SoundActive(handle))
         return;
+
+    FX_SetPan ( handle, vol, left, right );
 }
 
 //***************************************************************************
@@ -613,6 +635,9 @@ void SD_PanPositionedSound ( int handle, int px, int py, int x, int y )
     {
         angle = 0;
     }
+
+    FX_Pan3D ( handle, angle, distance );
+    SD_OccludeSound ( handle, x, y );
 }
 
 
@@ -634,6 +659,176 @@ void SD_StopSound ( int handle )
     
 }
 
+//***************************************************************************
+//
+// SD_Update - Run the callbacks of sounds that finished since the last tic
+//
+//***************************************************************************
+
+void SD_Update ( void )
+{
+    if (SD_Started==false)
+        return;
+
+    FX_ServiceVoices();
+}
+
+//***************************************************************************
+//
+// SD_SetupAreaZones - Work out the reverb of every area of a new level
+//
+//***************************************************************************
+
+void SD_SetupAreaZones ( void )
+{
+    int i;
+
+    for (i = 0; i <= NUMAREAS; i++)
+        areareverb[i] = min( numareatiles[i] >> 1, 90 );
+
+    listenerarea = -1;
+    areaschanged = true;
+    currentreverb = -1;
+}
+
+//***************************************************************************
+//
+// SD_AreasChanged - Doors or pushwalls changed which areas are connected
+//
+//***************************************************************************
+
+void SD_AreasChanged ( void )
+{
+    areaschanged = true;
+}
+
+//***************************************************************************
+//
+// SD_ConnectListener - Mark the areas reachable from the listener's area
+//
+//***************************************************************************
+
+static void SD_ConnectListener ( int area )
+{
+    int stack[NUMAREAS];
+    int sp;
+    int i;
+
+    memset (listenerareas, 0, sizeof(listenerareas));
+    if ((area < 0) || (area >= NUMAREAS))
+        return;
+
+    listenerareas[area] = true;
+    stack[0] = area;
+    sp = 1;
+    while (sp > 0)
+    {
+        area = stack[--sp];
+        for (i = 0; i < NUMAREAS; i++)
+        {
+            if (areaconnect[area][i] && !listenerareas[i])
+            {
+                listenerareas[i] = true;
+                stack[sp++] = i;
+            }
+        }
+    }
+}
+
+//***************************************************************************
+//
+// SD_SetReverb - Set the reverb level, only telling the sound device when
+//                it changes
+//
+//***************************************************************************
+
+void SD_SetReverb ( int reverb )
+{
+    if (SD_Started==false)
+        return;
+
+    if (reverb != currentreverb)
+    {
+        currentreverb = reverb;
+        FX_SetReverb( reverb );
+    }
+}
+
+//***************************************************************************
+//
+// SD_UpdateListener - Follow the player between sound zones, called once
+//                     per update
+//
+//***************************************************************************
+
+void SD_UpdateListener ( void )
+{
+    int reverb;
+
+    if (SD_Started==false)
+        return;
+
+    if ((player->areanumber != listenerarea) || (areaschanged == true))
+    {
+        listenerarea = player->areanumber;
+        areaschanged = false;
+        SD_ConnectListener (listenerarea);
+    }
+
+    if (noecho == true)
+        return;
+
+    if ( player->flags & FL_SHROOMS )
+        reverb = 230;
+    else if (sky == 0)
+        reverb = areareverb[ listenerarea ];
+    else
+        return;
+
+    SD_SetReverb (reverb);
+}
+
+//***************************************************************************
+//
+// SD_OccludeSound - Muffle a sound coming from an area the listener
+//                   can't reach
+//
+//***************************************************************************
+
+static void SD_OccludeSound ( int handle, int x, int y )
+{
+    int tilex;
+    int tiley;
+    int area;
+
+    tilex = x >> TILESHIFT;
+    tiley = y >> TILESHIFT;
+    if ((tilex < 0) || (tilex >= MAPSIZE) || (tiley < 0) || (tiley >= MAPSIZE))
+        return;
+
+    // Doors and walls have no area, leave them unmuffled
+    area = AREANUMBER (tilex, tiley);
+    if ((area < 0) || (area >= NUMAREAS))
+        return;
+
+    FX_SetOcclusion ( handle, !listenerareas[area] );
+}
+
+//***************************************************************************
+//
+// SD_FlushUpdates - Send the pans and pitches changed this update to the
+//                   sound device in one batch
+//
+//***************************************************************************
+
+void SD_FlushUpdates ( void )
+{
+    if (SD_Started==false)
+        return;
+
+    FX_FlushVoiceUpdates();
+}
+
 //***************************************************************************
 //
 // SD_StopAllSounds - Stop All the sounds currently playing
@@ -801,6 +996,21 @@ static char * currentsong;
 static int MU_Started=false;
 static int lastsongnumber=-1;
 int storedposition=0;
+boolean musiccache=false;
+
+//***************************************************************************
+//
+// MU_SongCacheName - where the pre-rendered PCM for a song is kept
+//
+//***************************************************************************
+
+static void MU_SongCacheName ( int num, char * filename )
+{
+    char name[16];
+
+    snprintf (name, sizeof(name), "%s.MPC", rottsongs[num].lumpname);
+    GetPathFromEnvironment (filename, ApogeePath, name);
+}
 
 //****************************************************************************
 //
@@ -970,6 +1180,8 @@ void MU_PlaySong ( int num )
 {
     int lump;
     int size;
+    int loopflag;
+    char filename[ 300 ];
 
     if (MU_Started==false)
         return;
@@ -990,13 +1202,60 @@ void MU_PlaySong ( int num )
     currentsong=W_CacheLumpNum(lump,PU_STATIC, CvtNull, 1);
 
     if (rottsongs[num].loopflag == loop_yes)
-        MUSIC_PlaySongROTT(currentsong,size,MUSIC_LoopSong);
+        loopflag = MUSIC_LoopSong;
+    else
+        loopflag = MUSIC_PlayOnce;
+
+    if (musiccache == true)
+    {
+        MU_SongCacheName (num, filename);
+        MUSIC_PlaySongCached(currentsong,size,loopflag,filename);
+    }
     else
-        MUSIC_PlaySongROTT(currentsong,size,MUSIC_PlayOnce);
+        MUSIC_PlaySongROTT(currentsong,size,loopflag);
 
     MU_SetVolume (MUvolume);
 }
 
+//***************************************************************************
+//
+// MU_RenderSongCache - Pre-render every song so none is synthesized in game
+//
+//***************************************************************************
+
+void MU_RenderSongCache ( void )
+{
+    int i;
+    int lump;
+    char filename[ 300 ];
+    char * song;
+
+    if (MU_Started==false)
+        return;
+
+    musiccache = true;
+
+    for (i=0; i<MAXSONGS; i++)
+    {
+        lump = W_CheckNumForName(rottsongs[i].lumpname);
+        if (lump == -1)
+            continue;
+
+        if (!quiet)
+            printf ("MU_RenderSongCache: %s\n", rottsongs[i].songname);
+
+        MU_SongCacheName (i, filename);
+        song = W_CacheLumpNum(lump,PU_STATIC, CvtNull, 1);
+        if (MUSIC_RenderSongCache(song, W_LumpLength(lump), filename) != MUSIC_Ok)
+        {
+            if (!quiet)
+                printf ("MU_RenderSongCache: %s failed, %s\n",
+                        rottsongs[i].songname, MUSIC_ErrorString (MUSIC_Error));
+        }
+        W_CacheLumpNum(lump,PU_CACHE, CvtNull, 1);
+    }
+}
+
 //***************************************************************************
 //
 // MU_StopSong - Play a specific song number
@@ -493,6 +493,7 @@ typedef enum {
 
 
 extern int SD_Started;
+extern boolean musiccache;
 
 int SD_SetupFXCard ( int * numvoices, int * numbits, int * numchannels);
 int SD_Startup ( boolean bombonerror );
@@ -530,6 +531,48 @@ void  SD_StopSound ( int handle );
 //***************************************************************************
 int SD_SoundActive ( int handle );
 
+//***************************************************************************
+//
+// SD_Update
+//
+//***************************************************************************
+void SD_Update ( void );
+
+//***************************************************************************
+//
+// SD_SetupAreaZones
+//
+//***************************************************************************
+void SD_SetupAreaZones ( void );
+
+//***************************************************************************
+//
+// SD_AreasChanged
+//
+//***************************************************************************
+void SD_AreasChanged ( void );
+
+//***************************************************************************
+//
+// SD_SetReverb
+//
+//***************************************************************************
+void SD_SetReverb ( int reverb );
+
+//***************************************************************************
+//
+// SD_UpdateListener
+//
+//***************************************************************************
+void SD_UpdateListener ( void );
+
+//***************************************************************************
+//
+// SD_FlushUpdates
+//
+//***************************************************************************
+void SD_FlushUpdates ( void );
+
 //***************************************************************************
 //
 // SD_StopAllSounds
@@ -565,6 +608,7 @@ void MU_Shutdown ( void );
 int MU_Startup ( boolean bombonerror );
 void MU_PlaySong ( int num );
 void MU_StopSong ( void );
+void MU_RenderSongCache ( void );
 
 //***************************************************************************
 //
@@ -688,31 +688,31 @@ void DoLights (int tilex, int tiley)
     if (lightsource==0)
         return;
     if (TurnOffLight0 (tilex, tiley))
-        LightSourceAt(tilex,tiley) = 0;
+        ClearLight(tilex,tiley);
 
     if (TurnOffLight1 (tilex, tiley, -1, -1))
-        LightSourceAt(tilex-1,tiley-1) = 0;
+        ClearLight(tilex-1,tiley-1);
 
     if (TurnOffLight2 (tilex, tiley, -1))
-        LightSourceAt(tilex,tiley-1) = 0;
+        ClearLight(tilex,tiley-1);
 
     if (TurnOffLight1 (tilex, tiley, 1, -1))
-        LightSourceAt(tilex+1,tiley-1) = 0;
+        ClearLight(tilex+1,tiley-1);
 
     if (TurnOffLight3 (tilex, tiley, 1))
-        LightSourceAt(tilex+1,tiley) = 0;
+        ClearLight(tilex+1,tiley);
 
     if (TurnOffLight1 (tilex, tiley, 1, 1))
-        LightSourceAt(tilex+1,tiley+1) = 0;
+        ClearLight(tilex+1,tiley+1);
 
     if (TurnOffLight2 (tilex, tiley, 1))
-        LightSourceAt(tilex,tiley+1) = 0;
+        ClearLight(tilex,tiley+1);
 
     if (TurnOffLight1 (tilex, tiley, -1, 1))
-        LightSourceAt(tilex-1,tiley+1) = 0;
+        ClearLight(tilex-1,tiley+1);
 
     if (TurnOffLight3 (tilex, tiley, -1))
-        LightSourceAt(tilex-1,tiley) = 0;
+        ClearLight(tilex-1,tiley);
 }
 
 
@@ -68,6 +68,30 @@ int fontcolor;
 static int BKw;
 static int BKh;
 
+//
+// Glyph atlas, see rt_str.h
+//
+
+#define MAXFONTATLASES   8
+
+typedef struct
+{
+    short height;
+    char  width[256];
+    short charofs[256];
+} fontheader_t;
+
+struct fontatlas_s
+{
+    const byte   *font;
+    fontheader_t  header;         // copy to notice a different lump here
+    byte          transparent;
+    fontglyph_t   glyphs[256];
+};
+
+static fontatlas_t    fontatlases[MAXFONTATLASES];
+static int            nextfontatlas;
+
 static char strbuf[MaxString];
 
 //******************************************************************************
@@ -151,6 +175,188 @@ void US_ClippedPrint (int x, int y, const char *string)
 }
 
 
+
+//******************************************************************************
+//
+// FindFontAtlas ()
+//
+// Fonts are cached lumps, so the same address can later hold a different
+// font.  The header copy catches that and the atlas is rebuilt.
+//
+//******************************************************************************
+
+static fontatlas_t * FindFontAtlas (const void *font, const fontheader_t *header, byte transparent)
+{
+    fontatlas_t *atlas;
+    int i;
+
+    for (i = 0; i < MAXFONTATLASES; i++)
+    {
+        atlas = &fontatlases[i];
+        if ((atlas->font == font) &&
+                !memcmp (&atlas->header, header, sizeof(fontheader_t)))
+            return atlas;
+    }
+
+    for (i = 0; i < MAXFONTATLASES; i++)
+        if (fontatlases[i].font == font)
+            break;
+
+    if (i == MAXFONTATLASES)
+    {
+        i = nextfontatlas;
+        nextfontatlas = (nextfontatlas + 1) % MAXFONTATLASES;
+    }
+
+    atlas = &fontatlases[i];
+    for (i = 0; i < 256; i++)
+    {
+        if (atlas->glyphs[i].pixels != NULL)
+            SafeFree (atlas->glyphs[i].pixels);
+    }
+    memset (atlas->glyphs, 0, sizeof(atlas->glyphs));
+
+    atlas->font = font;
+    memcpy (&atlas->header, header, sizeof(fontheader_t));
+    atlas->transparent = transparent;
+
+    return atlas;
+}
+
+
+//******************************************************************************
+//
+// GetFontAtlas () / GetIFontAtlas ()
+//
+//******************************************************************************
+
+fontatlas_t * GetFontAtlas (const font_t *font)
+{
+    return FindFontAtlas (font, (const fontheader_t *)&font->height, 0);
+}
+
+fontatlas_t * GetIFontAtlas (const cfont_t *font)
+{
+    return FindFontAtlas (font, (const fontheader_t *)&font->height, 0xFE);
+}
+
+
+//******************************************************************************
+//
+// EncodeRuns ()
+//
+// Writes the opaque runs of count pixels, returns the next free entry of
+// runs
+//
+//******************************************************************************
+
+static short * EncodeRuns (short *runs, const byte *src, int count, byte transparent)
+{
+    short *num;
+    int    i;
+
+    num = runs++;
+    *num = 0;
+
+    for (i = 0; i < count; )
+    {
+        if (src[i] == transparent)
+        {
+            i++;
+            continue;
+        }
+
+        *runs++ = i;
+        while ((i < count) && (src[i] != transparent))
+            i++;
+        *runs = i - runs[-1];
+        runs++;
+        (*num)++;
+    }
+
+    return runs;
+}
+
+
+//******************************************************************************
+//
+// GetAtlasGlyph ()
+//
+//******************************************************************************
+
+fontglyph_t * GetAtlasGlyph (fontatlas_t *atlas, int ch)
+{
+    fontglyph_t *glyph;
+    const byte  *src;
+    short       *runs;
+    int          width;
+    int          height;
+    int          x;
+    int          y;
+
+    ch &= 0xff;
+    glyph = &atlas->glyphs[ch];
+    if (glyph->pixels != NULL)
+        return glyph;
+
+    width  = atlas->header.width[ch];
+    height = atlas->header.height;
+    if (width < 0)
+        width = 0;
+
+    src = atlas->font + atlas->header.charofs[ch];
+
+    // a line of n pixels has at most (n+1)/2 runs
+    glyph->pixels = SafeMalloc (width*height + 1 + sizeof(short) *
+                                (height*(width+2) + width*(height+2)));
+    glyph->rowruns = (short *)(glyph->pixels + ((width*height + 1) & ~1));
+
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            glyph->pixels[y*width + x] = src[x*height + y];
+
+    runs = glyph->rowruns;
+    for (y = 0; y < height; y++)
+        runs = EncodeRuns (runs, glyph->pixels + y*width, width, atlas->transparent);
+
+    glyph->colruns = runs;
+    for (x = 0; x < width; x++)
+        runs = EncodeRuns (runs, src + x*height, height, atlas->transparent);
+
+    return glyph;
+}
+
+
+//******************************************************************************
+//
+// DrawGlyph ()
+//
+// Row wise masked copy of a glyph to dest at linewidth stride
+//
+//******************************************************************************
+
+static void DrawGlyph (const fontglyph_t *glyph, int width, int height, byte *dest)
+{
+    const short *runs;
+    const byte  *src;
+    int          num;
+
+    runs = glyph->rowruns;
+    src  = glyph->pixels;
+
+    while (height--)
+    {
+        num = *runs++;
+        while (num--)
+        {
+            memcpy (dest + runs[0], src + runs[0], runs[1]);
+            runs += 2;
+        }
+        src  += width;
+        dest += linewidth;
+    }
+}
+
 //******************************************************************************
 //
 // VW_DrawPropString ()
@@ -161,39 +367,27 @@ void US_ClippedPrint (int x, int y, const char *string)
 
 void VW_DrawPropString (const char *string)
 {
-    byte  pix;
-    int   width,step,height,ht;
-    byte  *source, *dest, *origdest;
+    fontatlas_t *atlas;
+    int   width,ht;
+    byte  *dest;
     int   ch;
+    int   x;
 
+    atlas = GetFontAtlas (CurrentFont);
     ht = CurrentFont->height;
-    dest = origdest = (byte *)(bufferofs+ylookup[py]+px);
+    dest = (byte *)(bufferofs+ylookup[py]+px);
+    x = px;
 
     while ((ch = (unsigned char)*string++)!=0)
     {
-        ch -= 31;
-        width = step = CurrentFont->width[ch];
-        source = ((byte *)CurrentFont)+CurrentFont->charofs[ch];
-        while (width--)
-        {
-            height = ht;
-            while (height--)
-            {
-                pix = *source;
-                if (pix)
-                    *dest = pix;
-
-                source++;
-                dest += linewidth;
-            }
-
-            px++;
-            origdest++;
-            dest = origdest;
-        }
+        ch = (ch - 31) & 0xff;
+        width = CurrentFont->width[ch];
+        DrawGlyph (GetAtlasGlyph (atlas, ch), width, ht, dest);
+        px += width;
+        dest += width;
     }
     bufferheight = ht;
-    bufferwidth = ((dest+1)-origdest);
+    bufferwidth = px - x;
 }
 
 
@@ -226,40 +420,27 @@ void VWB_DrawPropString  (const char *string)
 
 void VW_DrawIPropString (const char *string)
 {
-    byte  pix;
-    int   width,step,height,ht;
-    byte  *source, *dest, *origdest;
+    fontatlas_t *atlas;
+    int   width,ht;
+    byte  *dest;
     int   ch;
+    int   x;
 
+    atlas = GetFontAtlas (CurrentFont);
     ht = CurrentFont->height;
-    dest = origdest = (byte *)(bufferofs+ylookup[py]+px);
+    dest = (byte *)(bufferofs+ylookup[py]+px);
+    x = px;
 
     while ((ch = (unsigned char)*string++)!=0)
     {
-        ch -= 31;
-        width = step = CurrentFont->width[ch];
-        source = ((byte *)CurrentFont)+CurrentFont->charofs[ch];
-        while (width--)
-        {
-            height = ht;
-            while (height--)
-            {
-                pix = *source;
-                if (pix)
-                    *dest = pix;
-
-                source++;
-                dest += linewidth;
-            }
-
-            px++;
-            origdest++;
-            dest = origdest;
-        }
+        ch = (ch - 31) & 0xff;
+        width = CurrentFont->width[ch];
+        DrawGlyph (GetAtlasGlyph (atlas, ch), width, ht, dest);
+        px += width;
+        dest += width;
     }
     bufferheight = ht;
-    bufferwidth = ((dest+1)-origdest);
-
+    bufferwidth = px - x;
 }
 
 
@@ -1411,72 +1592,63 @@ byte GetIntensityColor (byte pix)
 
 void DrawIntensityChar  ( char ch )
 {
-
+    fontglyph_t *glyph;
+    const short *runs;
+    const byte  *src;
+    const byte  *map;
+    byte  *dest;
     byte  pix;
     int   width;
     int   height;
-    int   ht;
-    byte  *source;
-    byte  *dest;
-    byte  *origdest;
-
-    ht = IFont->height;
+    int   num;
+    int   i;
 
-    origdest = ( byte * )( bufferofs + ylookup[ py ] + px );
-
-    dest = origdest;
+    if ((fontcolor<0) || (fontcolor>255))
+        Error("Intensity Color out of range\n");
+    map = intensitytable + fontcolor;
 
     ch -= 31;
     width = IFont->width[ (unsigned char)ch ];
-    source = ( ( byte * )IFont ) + IFont->charofs[ (unsigned char)ch ];
+    glyph = GetAtlasGlyph( GetIFontAtlas( IFont ), (unsigned char)ch );
+
+    runs = glyph->rowruns;
+    src  = glyph->pixels;
+    dest = ( byte * )( bufferofs + ylookup[ py ] + px );
 
     if ((iGLOBAL_SCREENWIDTH <= 320)||(StretchScreen == true)) {
-        while( width-- )
+        for (height = IFont->height; height > 0; height--)
         {
-            height = ht;
-            while( height-- )
+            num = *runs++;
+            while (num--)
             {
-                pix = *source;
-                if ( pix != 0xFE )
-                {
-                    *dest = GetIntensityColor( pix );
-                }
-
-                source++;
-                dest += linewidth;
+                for (i = runs[0]; i < runs[0] + runs[1]; i++)
+                    dest[i] = map[ src[i] << 8 ];
+                runs += 2;
             }
-
-            px++;
-            origdest++;
-            dest = origdest;
+            src  += width;
+            dest += linewidth;
         }
+        px += width;
     } else { //strech letter in x any direction
-        while( width-- )
+        for (height = IFont->height; height > 0; height--)
         {
-            height = ht;
-            while( height-- )
+            num = *runs++;
+            while (num--)
             {
-                pix = *source;
-                if ( pix != 0xFE )
+                for (i = runs[0]; i < runs[0] + runs[1]; i++)
                 {
-                    *dest = GetIntensityColor( pix );
-                    *(dest+iGLOBAL_SCREENWIDTH) = GetIntensityColor( pix );
-
-                    *(dest+1) = GetIntensityColor( pix );
-                    *(dest+1+iGLOBAL_SCREENWIDTH) = GetIntensityColor( pix );
+                    pix = map[ src[i] << 8 ];
+                    dest[i*2] = pix;
+                    dest[i*2+1] = pix;
+                    dest[i*2+iGLOBAL_SCREENWIDTH] = pix;
+                    dest[i*2+1+iGLOBAL_SCREENWIDTH] = pix;
                 }
-
-                source++;
-                dest += linewidth*2;
+                runs += 2;
             }
-
-            px++;
-            px++;
-            origdest++;
-            origdest++;
-            dest = origdest;
+            src  += width;
+            dest += linewidth*2;
         }
-
+        px += width*2;
     }
 
 }
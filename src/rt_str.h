@@ -59,6 +59,21 @@ typedef  struct
     Point ul,lr;
 } Rect;
 
+//
+// Fonts are stored column by column.  The glyph atlas expands each glyph on
+// first use into row major pixels plus the opaque runs of every row and
+// column, each as a count followed by start/length pairs.
+//
+
+typedef struct
+{
+    byte  *pixels;
+    short *rowruns;
+    short *colruns;
+} fontglyph_t;
+
+typedef struct fontatlas_s fontatlas_t;
+
 
 //***************************************************************************
 //
@@ -91,6 +106,14 @@ void US_PrintCentered (const char *s);
 void US_CPrintLine (const char *s);
 void US_CPrint (const char *s);
 
+//
+// Glyph atlas rtns
+//
+
+fontatlas_t * GetFontAtlas (const font_t *font);
+fontatlas_t * GetIFontAtlas (const cfont_t *font);
+fontglyph_t * GetAtlasGlyph (fontatlas_t *atlas, int ch);
+
 
 //
 // Input rtns
@@ -0,0 +1,310 @@
+/*
+Copyright (C) 1994-1995  Apogee Software, Ltd.
+Copyright (C) 2002-2015  icculus.org, GNU/Linux port
+Copyright (C) 2017-2018  Steven LeVesque
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "rt_def.h"
+#include "_rt_sync.h"
+#include "rt_sync.h"
+#include "rt_main.h"
+#include "rt_actor.h"
+#include "rt_stat.h"
+#include "rt_door.h"
+#include "rt_playr.h"
+#include "rt_net.h"
+#include "rt_rand.h"
+#include "rt_util.h"
+#include "z_zone.h"
+
+
+//****************************************************************************
+//
+// GLOBALS
+//
+//****************************************************************************
+
+boolean  hashrecord = false;
+boolean  hashverify = false;
+unsigned gamestatehash;
+
+#define HASHBUFFERSIZE 256
+
+static int          recordhandle = -1;
+static statehash_t  recordbuffer[HASHBUFFERSIZE];
+static int          recordcount;
+static int          recordtics;
+
+static byte        *goldenbuffer = NULL;
+static statehash_t *golden;
+static int          numgolden;
+static int          hashindex;
+
+
+//****************************************************************************
+//
+// HashValue ()
+//
+// Folds one scalar into a running FNV-1a hash, least significant byte first
+// so the result is the same on either byte order.
+//
+//****************************************************************************
+
+static unsigned HashValue (unsigned hash, int value)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        hash ^= (unsigned)(value & 0xff);
+        hash *= FNV_PRIME;
+        value >>= 8;
+    }
+    return hash;
+}
+
+//****************************************************************************
+//
+// CalculateGameStateHash ()
+//
+// Only plain values are hashed; pointers differ from run to run.
+//
+//****************************************************************************
+
+unsigned CalculateGameStateHash ( void )
+{
+    unsigned hash;
+    objtype *ob;
+    statobj_t *stat;
+    int i;
+
+    hash = FNV_OFFSET_BASIS;
+    hash = HashValue (hash, gamestate.TimeCount);
+    hash = HashValue (hash, GetRNGindex());
+
+    for (i = 0; i < numplayers; i++)
+    {
+        hash = HashValue (hash, PLAYERSTATE[i].health);
+        hash = HashValue (hash, PLAYERSTATE[i].lives);
+        hash = HashValue (hash, PLAYERSTATE[i].ammo);
+        hash = HashValue (hash, PLAYERSTATE[i].keys);
+        hash = HashValue (hash, PLAYERSTATE[i].new_weapon);
+        hash = HashValue (hash, PLAYERSTATE[i].missileweapon);
+    }
+
+    for (ob = FIRSTACTOR; ob; ob = ob->next)
+    {
+        hash = HashValue (hash, ob->obclass);
+        hash = HashValue (hash, ob->x);
+        hash = HashValue (hash, ob->y);
+        hash = HashValue (hash, ob->z);
+        hash = HashValue (hash, ob->angle);
+        hash = HashValue (hash, ob->yzangle);
+        hash = HashValue (hash, ob->dir);
+        hash = HashValue (hash, ob->flags);
+        hash = HashValue (hash, ob->hitpoints);
+        hash = HashValue (hash, ob->ticcount);
+        hash = HashValue (hash, ob->shapenum);
+        hash = HashValue (hash, ob->speed);
+        hash = HashValue (hash, ob->momentumx);
+        hash = HashValue (hash, ob->momentumy);
+        hash = HashValue (hash, ob->momentumz);
+        hash = HashValue (hash, ob->temp1);
+        hash = HashValue (hash, ob->temp2);
+        hash = HashValue (hash, ob->temp3);
+    }
+
+    for (stat = FIRSTSTAT; stat; stat = stat->statnext)
+    {
+        hash = HashValue (hash, stat->itemnumber);
+        hash = HashValue (hash, stat->x);
+        hash = HashValue (hash, stat->y);
+        hash = HashValue (hash, stat->z);
+        hash = HashValue (hash, stat->flags);
+        hash = HashValue (hash, stat->shapenum);
+        hash = HashValue (hash, stat->hitpoints);
+        hash = HashValue (hash, stat->ticcount);
+        hash = HashValue (hash, stat->count);
+        hash = HashValue (hash, stat->ammo);
+    }
+
+    for (i = 0; i < doornum; i++)
+    {
+        hash = HashValue (hash, doorobjlist[i]->position);
+        hash = HashValue (hash, doorobjlist[i]->action);
+        hash = HashValue (hash, doorobjlist[i]->flags);
+        hash = HashValue (hash, doorobjlist[i]->ticcount);
+        hash = HashValue (hash, doorobjlist[i]->lock);
+    }
+
+    for (i = 0; i < pwallnum; i++)
+    {
+        hash = HashValue (hash, pwallobjlist[i]->x);
+        hash = HashValue (hash, pwallobjlist[i]->y);
+        hash = HashValue (hash, pwallobjlist[i]->momentumx);
+        hash = HashValue (hash, pwallobjlist[i]->momentumy);
+        hash = HashValue (hash, pwallobjlist[i]->action);
+        hash = HashValue (hash, pwallobjlist[i]->state);
+        hash = HashValue (hash, pwallobjlist[i]->dir);
+        hash = HashValue (hash, pwallobjlist[i]->flags);
+    }
+
+    return hash;
+}
+
+//****************************************************************************
+//
+// FlushStateHash ()
+//
+//****************************************************************************
+
+static void FlushStateHash ( void )
+{
+    if ((recordhandle == -1) || (recordcount == 0))
+        return;
+
+    SafeWrite (recordhandle, recordbuffer, recordcount*sizeof(statehash_t));
+    recordcount = 0;
+}
+
+//****************************************************************************
+//
+// StartupStateHash ()
+//
+// recordname receives the hash stream of this run, verifyname is a golden
+// stream from an earlier run to compare against.  Either may be NULL.
+//
+//****************************************************************************
+
+void StartupStateHash ( char * recordname, char * verifyname )
+{
+    int magic;
+    long size;
+
+    if (recordname != NULL)
+    {
+        recordhandle = SafeOpenWrite (recordname);
+        magic = IntelLong (STATEHASH_MAGIC);
+        SafeWrite (recordhandle, &magic, sizeof(magic));
+        recordcount = 0;
+        recordtics = 0;
+        hashrecord = true;
+    }
+
+    if (verifyname != NULL)
+    {
+        size = LoadFile (verifyname, (void **)&goldenbuffer);
+        if ((size < (long)sizeof(int)) ||
+                (IntelLong(*(int *)goldenbuffer) != STATEHASH_MAGIC))
+            Error ("%s is not a state hash file\n", verifyname);
+
+        golden = (statehash_t *)(goldenbuffer + sizeof(int));
+        numgolden = (size - sizeof(int)) / sizeof(statehash_t);
+        hashverify = true;
+    }
+
+    hashindex = 0;
+}
+
+//****************************************************************************
+//
+// UpdateStateHash ()
+//
+// Called once per simulated tic from UpdateGameObjects
+//
+//****************************************************************************
+
+void UpdateStateHash ( void )
+{
+    statehash_t *expected;
+
+    if ((hashrecord == false) && (hashverify == false))
+        return;
+
+    gamestatehash = CalculateGameStateHash ();
+
+    if (hashrecord == true)
+    {
+        recordbuffer[recordcount].tic  = IntelLong (gamestate.TimeCount);
+        recordbuffer[recordcount].hash = IntelLong (gamestatehash);
+        recordcount++;
+        recordtics++;
+        if (recordcount == HASHBUFFERSIZE)
+            FlushStateHash ();
+    }
+
+    if (hashverify == true)
+    {
+        expected = &golden[hashindex];
+
+        // Stop verifying before erroring out, Error calls back into ShutDown
+
+        if (hashindex >= numgolden)
+        {
+            hashverify = false;
+            Error ("State hash stream ended after %d tics, game still running at tic %d\n",
+                   numgolden, gamestate.TimeCount);
+        }
+        if (IntelLong(expected->tic) != gamestate.TimeCount)
+        {
+            hashverify = false;
+            Error ("State hash tic mismatch: expected tic %d got tic %d\n",
+                   IntelLong(expected->tic), gamestate.TimeCount);
+        }
+        if ((unsigned)IntelLong(expected->hash) != gamestatehash)
+        {
+            hashverify = false;
+            Error ("State hash mismatch at tic %d: expected %08x got %08x\n",
+                   gamestate.TimeCount, (unsigned)IntelLong(expected->hash),
+                   gamestatehash);
+        }
+        hashindex++;
+    }
+}
+
+//****************************************************************************
+//
+// ShutdownStateHash ()
+//
+//****************************************************************************
+
+void ShutdownStateHash ( void )
+{
+    if (hashrecord == true)
+    {
+        FlushStateHash ();
+        close (recordhandle);
+        recordhandle = -1;
+        hashrecord = false;
+        if (!quiet)
+            printf ("State hash: recorded %d tics\n", recordtics);
+    }
+
+    if (goldenbuffer != NULL)
+    {
+        SafeFree (goldenbuffer);
+        goldenbuffer = NULL;
+        if (hashverify == true)
+        {
+            hashverify = false;
+            if (hashindex != numgolden)
+                Error ("State hash: only %d of %d tics verified\n", hashindex, numgolden);
+            if (!quiet)
+                printf ("State hash: all %d tics match\n", hashindex);
+        }
+    }
+}
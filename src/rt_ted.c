@@ -55,6 +55,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "rt_scale.h"
 #include "rt_net.h"
 #include "queue.h"
+#include "rt_map.h"
 
 
 
@@ -3139,6 +3140,22 @@ void SetupDoors (void)
     word *map;
     word tile;
     byte locked;
+    int count;
+
+    // Size the door list for this map up front
+
+    map = mapplanes[0];
+    count = 0;
+    for (i = 0; i < mapwidth*mapheight; i++)
+    {
+        tile = *map++;
+        if (((tile >= 33) && (tile <= 35)) ||
+                ((tile > 89) && (tile < 94)) ||
+                ((tile > 97) && (tile < 105)) ||
+                ((tile >= 154) && (tile <= 156)))
+            count++;
+    }
+    ReserveDoors (count);
 
     map = mapplanes[0];
 
@@ -5388,6 +5405,8 @@ void SetupGameLevel (void)
 
     ResetCheatCodes();
 
+    ResetMapCache();
+
     gamestate.killtotal     = gamestate.killcount     = 0;
     gamestate.secrettotal   = gamestate.secretcount   = 0;
     gamestate.treasuretotal = gamestate.treasurecount = 0;
@@ -5448,6 +5467,7 @@ void SetupGameLevel (void)
     */
 // pheight=maxheight-32;
     CountAreaTiles();
+    SD_SetupAreaZones();
     SetupWalls();
 
     SetupClocks();
@@ -5501,6 +5521,9 @@ void SetupGameLevel (void)
 
     LoftSprites();
 
+    // Leave room for everything on the level to be in view at once
+    SetVisibleListSize (objcount+statcount+maskednum+doornum+(pwallnum<<1));
+
     SetPlaneViewSize();
     if (loadedgame==false)
     {
@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //***************************************************************************
 
 void VH_UpdateScreen (void);
+void VH_UpdateDirtyScreen (byte *blocks, int wide, int high, int shift);
 void JoyStick_Vals (void);
 
 #endif
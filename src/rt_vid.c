@@ -542,7 +542,8 @@ int VW_MarkUpdateBlock (int x1, int y1, int x2, int y2)
 
 void VW_UpdateScreen (void)
 {
-    VH_UpdateScreen ();
+    VH_UpdateDirtyScreen (updateptr, UPDATEWIDE, UPDATEHIGH, PIXTOBLOCK);
+    memset (updateptr, 0, UPDATESIZE);
 }
 
 //===========================================================================
@@ -32,6 +32,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "rt_menu.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "rt_main.h"
 #include "rt_battl.h"
@@ -84,6 +85,9 @@ byte   gammatable[GAMMAENTRIES];
 int    gammaindex;
 int    focalwidth=160;
 int    yzangleconverter;
+int    renderheight;
+boolean dynamicresolution=false;
+int    dynamictarget=DEFAULTDYNAMICTARGET;
 byte   uniformcolors[MAXPLAYERCOLORS]= {
     25,
     222,
@@ -131,6 +135,50 @@ static int      lightningsoundtime=0;
 static boolean  periodic=false;
 static int      periodictime=0;
 
+//
+// Dynamic resolution: the 3D view is drawn at viewscale/VIEWSCALEUNIT of
+// its size and scaled up by EndDynamicView
+//
+
+typedef struct
+{
+    int      viewwidth;
+    int      viewheight;
+    int      centerx;
+    int      centery;
+    int      centeryfrac;
+    int      yzangleconverter;
+    int      weaponscale;
+    int      renderheight;
+    fixed    scale;
+    longword heightnumerator;
+} viewparms_t;
+
+static int         viewscale=VIEWSCALEUNIT;
+static int         drawaverage=0;
+static int         scalecooldown=0;
+static viewparms_t fullview;
+static short       fullpixelangle[MAXSCREENWIDTH];
+
+//
+// pixelangle only depends on centerx, the tables for the last few view
+// widths are kept so changing the view size doesn't rebuild them
+//
+
+#define PROJECTIONCACHESIZE 8
+
+typedef struct
+{
+    int      centerx;
+    int      lastused;
+    short  * pixelangle;
+} projection_t;
+
+static projection_t projections[PROJECTIONCACHESIZE];
+static int          projectionuse=0;
+static int        * projangles=NULL;
+static int          numprojangles;
+
 void SetViewDelta ( void );
 void UpdatePeriodicLighting (void);
 
@@ -186,6 +234,41 @@ void SetViewDelta ( void )
     heightnumerator = (((focalwidth/10)*centerx*4096)<<HEIGHTFRACTION);
 }
 
+/*
+====================
+=
+= LoadProjectionAngles
+=
+= Pulls the angle table out of the tables lump once
+=
+====================
+*/
+
+static void LoadProjectionAngles ( void )
+{
+    byte * table;
+    byte * ptr;
+    int   i;
+
+//Hey, isn't this stuff already loaded in?
+//Why don't we make this a lump?
+    table=W_CacheLumpName("tables",PU_STATIC, CvtNull, 1);
+    ptr=table;
+
+//
+// get size of table
+//
+
+    memcpy(&numprojangles,ptr,sizeof(int));
+    SwapIntelLong(&numprojangles);
+    ptr+=sizeof(int);
+    projangles=SafeMalloc(numprojangles*sizeof(int));
+    memcpy(projangles,ptr,numprojangles*sizeof(int));
+    for (i=0; i<numprojangles; i++)
+        SwapIntelLong(&projangles[i]);
+    table=W_CacheLumpName("tables",PU_CACHE, CvtNull, 1);
+}
+
 /*
 ====================
 =
@@ -199,48 +282,48 @@ void CalcProjection ( void )
     int   i;
     int   frac;
     int   intang;
-    byte * table;
-    byte * ptr;
-    int   length;
-    int  * pangle;
-
-
+    projection_t * proj;
 
 // Already being called in ResetFocalWidth
 //    SetViewDelta();
 
-//
-// load in tables file
-//
+    projectionuse++;
 
-
-//Hey, isn't this stuff already loaded in?
-//Why don't we make this a lump?
-    table=W_CacheLumpName("tables",PU_STATIC, CvtNull, 1);
-    ptr=table;
+    proj=&projections[0];
+    for (i=0; i<PROJECTIONCACHESIZE; i++)
+    {
+        if ((projections[i].pixelangle!=NULL) && (projections[i].centerx==centerx))
+        {
+            proj=&projections[i];
+            proj->lastused=projectionuse;
+            memcpy(pixelangle,proj->pixelangle,(centerx<<1)*sizeof(short));
+            return;
+        }
+        if (projections[i].lastused<proj->lastused)
+            proj=&projections[i];
+    }
 
 //
-// get size of table
+// build the table for a new width in the least recently used slot
 //
 
-    memcpy(&length,ptr,sizeof(int));
-    SwapIntelLong(&length);
-    ptr+=sizeof(int);
-    pangle=SafeMalloc(length*sizeof(int));
-    memcpy(pangle,ptr,length*sizeof(int));
+    if (projangles==NULL)
+        LoadProjectionAngles();
+    if (proj->pixelangle==NULL)
+        proj->pixelangle=SafeMalloc(MAXSCREENWIDTH*sizeof(short));
+    proj->centerx=centerx;
+    proj->lastused=projectionuse;
 
-    frac=((length*65536/centerx))>>1;
+    frac=((numprojangles*65536/centerx))>>1;
     for (i=0; i<centerx; i++)
     {
         // start 1/2 pixel over, so viewangle bisects two middle pixels
-        intang=pangle[frac>>16];
-        SwapIntelLong(&intang);
-        pixelangle[centerx-1-i] =(short) intang;
-        pixelangle[centerx+i] =(short) -intang;
-        frac+=(length*65536/centerx);
+        intang=projangles[frac>>16];
+        proj->pixelangle[centerx-1-i] =(short) intang;
+        proj->pixelangle[centerx+i] =(short) -intang;
+        frac+=(numprojangles*65536/centerx);
     }
-    table=W_CacheLumpName("tables",PU_CACHE, CvtNull, 1);
-    SafeFree(pangle);
+    memcpy(pixelangle,proj->pixelangle,(centerx<<1)*sizeof(short));
 }
 
 
@@ -379,6 +462,153 @@ void SetViewSize
 
     CalcProjection();
 
+    renderheight = iGLOBAL_SCREENHEIGHT;
+
+}
+
+
+//******************************************************************************
+//
+// BeginDynamicView ()
+//
+// Switches the view parameters to the reduced size for one refresh, returns
+// false when the view is drawn at full size.
+//
+//******************************************************************************
+
+boolean BeginDynamicView ( void )
+{
+    if ((dynamicresolution == false) || (viewscale == VIEWSCALEUNIT))
+        return false;
+
+    fullview.viewwidth = viewwidth;
+    fullview.viewheight = viewheight;
+    fullview.centerx = centerx;
+    fullview.centery = centery;
+    fullview.centeryfrac = centeryfrac;
+    fullview.yzangleconverter = yzangleconverter;
+    fullview.weaponscale = weaponscale;
+    fullview.renderheight = renderheight;
+    fullview.scale = scale;
+    fullview.heightnumerator = heightnumerator;
+    memcpy (fullpixelangle, pixelangle, viewwidth*sizeof(short));
+
+    viewwidth  = ((viewwidth * viewscale) >> VIEWSCALEBITS) & ~1;
+    viewheight = ((viewheight * viewscale) >> VIEWSCALEBITS) & ~1;
+    centerx = viewwidth >> 1;
+    centery = (centery * viewscale) >> VIEWSCALEBITS;
+    centeryfrac = (centery << 16);
+    yzangleconverter = (yzangleconverter * viewscale) >> VIEWSCALEBITS;
+    weaponscale = (weaponscale * viewscale) >> VIEWSCALEBITS;
+    renderheight = (renderheight * viewscale) >> VIEWSCALEBITS;
+
+    // focalwidth may have been changed since the last refresh
+    SetViewDelta();
+
+    CalcProjection();
+
+    return true;
+}
+
+
+//******************************************************************************
+//
+// EndDynamicView ()
+//
+// Scales the reduced view in bufferofs up to the full view window and puts
+// the full size view parameters back.  The view is scaled in place from the
+// bottom right, so no source pixel is overwritten before it is read.
+//
+//******************************************************************************
+
+void EndDynamicView ( void )
+{
+    static int xsource[MAXSCREENWIDTH];
+    byte *src;
+    byte *dest;
+    int   x;
+    int   y;
+    int   sy;
+    int   lastsy;
+
+    for (x = 0; x < fullview.viewwidth; x++)
+        xsource[x] = (x * viewwidth) / fullview.viewwidth;
+
+    lastsy = -1;
+    for (y = fullview.viewheight - 1; y >= 0; y--)
+    {
+        sy = (y * viewheight) / fullview.viewheight;
+        dest = bufferofs + ylookup[y];
+
+        if (sy == lastsy)
+        {
+            memcpy (dest, dest + linewidth, fullview.viewwidth);
+            continue;
+        }
+
+        src = bufferofs + ylookup[sy];
+        for (x = fullview.viewwidth - 1; x >= 0; x--)
+            dest[x] = src[xsource[x]];
+        lastsy = sy;
+    }
+
+    viewwidth = fullview.viewwidth;
+    viewheight = fullview.viewheight;
+    centerx = fullview.centerx;
+    centery = fullview.centery;
+    centeryfrac = fullview.centeryfrac;
+    yzangleconverter = fullview.yzangleconverter;
+    weaponscale = fullview.weaponscale;
+    renderheight = fullview.renderheight;
+    scale = fullview.scale;
+    heightnumerator = fullview.heightnumerator;
+    memcpy (pixelangle, fullpixelangle, viewwidth*sizeof(short));
+}
+
+
+//******************************************************************************
+//
+// UpdateDynamicResolution ()
+//
+// Feeds the time the last refresh took, in microseconds, into a moving
+// average and steps the view scale towards dynamictarget.  The scale only
+// moves up when the predicted cost at the next step still fits.
+//
+//******************************************************************************
+
+void UpdateDynamicResolution ( int refreshtime )
+{
+    int next;
+
+    if (dynamicresolution == false)
+        return;
+
+    if (drawaverage == 0)
+        drawaverage = refreshtime;
+    else
+        drawaverage += (refreshtime - drawaverage) >> 3;
+
+    if (scalecooldown > 0)
+    {
+        scalecooldown--;
+        return;
+    }
+
+    if ((drawaverage > dynamictarget) && (viewscale > MINVIEWSCALE))
+    {
+        viewscale--;
+        scalecooldown = DYNAMICCOOLDOWN;
+    }
+    else if (viewscale < VIEWSCALEUNIT)
+    {
+        next = viewscale + 1;
+        if ((long long)drawaverage * next * next <
+                (long long)dynamictarget * viewscale * viewscale * 7 / 8)
+        {
+            viewscale = next;
+            scalecooldown = DYNAMICCOOLDOWN;
+        }
+    }
 }
 
 
@@ -534,6 +764,8 @@ void SetupLightLevels ( void )
             lightsource=1;
             lights=Z_Malloc(MAPSIZE*MAPSIZE*(sizeof(unsigned long)),PU_LEVEL,NULL);
             memset (lights,0,MAPSIZE*MAPSIZE*(sizeof(unsigned long)));
+            tilelights=Z_Malloc(MAPSIZE*MAPSIZE*8,PU_LEVEL,NULL);
+            memset (tilelights,0,MAPSIZE*MAPSIZE*8);
         }
         else
             Error("You cannot use light sourcing on a level with fog on map %d\n",gamestate.mapon);
@@ -28,6 +28,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define HEIGHTFRACTION 6
 #define MAXVIEWSIZES   11
 
+#define VIEWSCALEBITS        4
+#define VIEWSCALEUNIT        (1<<VIEWSCALEBITS)
+#define MINVIEWSCALE         (VIEWSCALEUNIT/2)
+#define DYNAMICCOOLDOWN      8                  // refreshes between scale steps
+#define DEFAULTDYNAMICTARGET 8333               // microseconds
+
 //#define FOCALWIDTH 160//160
 //#define FPFOCALWIDTH 160.0//160.0
 
@@ -104,6 +110,9 @@ extern  int weaponscale;
 extern  int viewsize;
 extern  int focalwidth;
 extern  int yzangleconverter;
+extern  int renderheight;
+extern  boolean dynamicresolution;
+extern  int dynamictarget;
 extern  int lightninglevel;
 extern  boolean  lightning;
 extern  int    darknesslevel;
@@ -113,6 +122,9 @@ void SetupScreen ( boolean flip );
 void ResetFocalWidth ( void );
 void ChangeFocalWidth ( int amount );
 void SetViewSize ( int size );
+boolean BeginDynamicView ( void );
+void EndDynamicView ( void );
+void UpdateDynamicResolution ( int refreshtime );
 void LoadColorMap( void );
 void UpdateLightLevel (int area);
 void SetIllumination (int level);